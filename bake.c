@@ -0,0 +1,156 @@
+//
+// Offline atlas baker
+//
+// Runs the same packing and rasterization as mv_ef_init() and writes the result out as a C header,
+// with the atlas pages as a run-length encoded byte array, the glyph metrics and the line metrics.
+// Include the header after mv_easy_font.h and call mv_ef_init_baked() with it, and the program
+// never touches the filesystem for fonts.
+//
+// Usage: ./bake path/to/font.ttf font_size output.h [name] [face_index]
+//
+// face_index picks a face of a .ttc collection, 0 by default
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <glad/glad.c>
+
+// the baker uses the library internals directly, so the implementation goes first.
+// the baked header has to be produced with the same atlas settings the program using it is compiled with,
+// e.g. MV_EF_MIP_LEVELS, MV_EF_OVERSAMPLE_X/Y and MV_EF_COMPRESS_ATLAS. they are written into the header,
+// and mv_ef_init_baked() refuses a header baked with different ones
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+#define MV_EF_NO_CACHE
+#define MV_EASY_FONT_IMPLEMENTATION
+#include "mv_easy_font.h"
+
+//
+// Run-length encoding, the inverse of mv_ef_rle_decompress().
+// runs of 3 or more equal bytes are stored as a control byte and the value,
+// everything else as literal spans. the empty space in an atlas makes this very effective
+//
+int rle_compress(const unsigned char *src, int size, unsigned char *dst)
+{
+    unsigned char *out = dst;
+    int i = 0;
+    while (i < size) {
+        int run = 1;
+        while (i + run < size && run < 128 && src[i + run] == src[i])
+            run++;
+
+        if (run >= 3) {
+            *out++ = 128 + run - 1;
+            *out++ = src[i];
+            i += run;
+            continue;
+        }
+
+        // literals, until the next run of 3 or the maximum span length
+        int start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && src[i] == src[i+1] && src[i] == src[i+2])
+                break;
+            i++;
+        }
+
+        *out++ = i - start - 1;
+        memcpy(out, src + start, i - start);
+        out += i - start;
+    }
+
+    return out - dst;
+}
+
+// a float as a C literal that round-trips exactly, e.g. "22.878931f" or "0.0f"
+const char *float_literal(float x, char *buf)
+{
+    sprintf(buf, "%.9g", x);
+    if (!strpbrk(buf, ".e"))
+        strcat(buf, ".0");
+    strcat(buf, "f");
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        printf("Usage: %s path/to/font.ttf font_size output.h [name] [face_index]\n", argv[0]);
+        return 1;
+    }
+
+    const char *ttf_filename = argv[1];
+    int font_size = atoi(argv[2]);
+    const char *output_filename = argv[3];
+    const char *name = argc > 4 ? argv[4] : "mv_ef_baked";
+    int face_index = argc > 5 ? atoi(argv[5]) : 0;
+
+    if (font_size <= 0) {
+        printf("Error: invalid font size \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    mv_ef_context *ctx = mv_ef_default_context();
+    if (!mv_ef_open_font(ctx, ttf_filename, face_index, font_size))
+        return 1;
+    mv_ef_bake_atlas(ctx);
+
+    mv_ef_font *f = mv_ef_ctx_get_font(ctx);
+
+    int bitmap_size = f->width*f->height*f->num_pages;
+    unsigned char *compressed = (unsigned char*)malloc(bitmap_size + bitmap_size/128 + 1);
+    int compressed_size = rle_compress(f->bitmap, bitmap_size, compressed);
+
+    FILE *fp = fopen(output_filename, "w");
+    if (!fp) {
+        printf("Error: could not open \"%s\" for writing\n", output_filename);
+        return 1;
+    }
+
+    fprintf(fp, "// baked by bake.c from \"%s\" (face %d) at %dpx. do not edit\n", f->filename, f->face_index, font_size);
+    fprintf(fp, "// %dx%d atlas, %d page(s), %d bytes run-length encoded (%d raw)\n\n", f->width, f->height, f->num_pages, compressed_size, bitmap_size);
+
+    // x0, y0, x1, y1, xoff, yoff, xadvance, xoff2, yoff2
+    char b[5][32];
+    fprintf(fp, "static const stbtt_packedchar %s_cdata[%d] = {\n", name, NUM_GLYPHS);
+    for (int i = 0; i < NUM_GLYPHS; i++) {
+        stbtt_packedchar *c = &f->cdata[i];
+        fprintf(fp, "    {%3u, %3u, %3u, %3u, %s, %s, %s, %s, %s},\n", c->x0, c->y0, c->x1, c->y1,
+                float_literal(c->xoff, b[0]), float_literal(c->yoff, b[1]), float_literal(c->xadvance, b[2]),
+                float_literal(c->xoff2, b[3]), float_literal(c->yoff2, b[4]));
+    }
+    fprintf(fp, "};\n\n");
+
+    fprintf(fp, "static const int %s_glyph_layer[%d] = {", name, NUM_GLYPHS);
+    for (int i = 0; i < NUM_GLYPHS; i++)
+        fprintf(fp, "%s%d,", i % 24 == 0 ? "\n    " : " ", f->glyph_layer[i]);
+    fprintf(fp, "\n};\n\n");
+
+    fprintf(fp, "static const unsigned char %s_atlas[%d] = {", name, compressed_size);
+    for (int i = 0; i < compressed_size; i++)
+        fprintf(fp, "%s%d,", i % 24 == 0 ? "\n    " : "", compressed[i]);
+    fprintf(fp, "\n};\n\n");
+
+    fprintf(fp, "static const mv_ef_baked_font %s = {\n", name);
+    fprintf(fp, "    %s,\n", float_literal(f->font_size, b[0]));
+    fprintf(fp, "    %d, %d, %d,\n", f->width, f->height, f->num_pages);
+    fprintf(fp, "    %s, %s, %s,\n", float_literal(f->ascent, b[0]), float_literal(f->descent, b[1]), float_literal(f->linegap, b[2]));
+    fprintf(fp, "    %s_cdata,\n", name);
+    fprintf(fp, "    %s_glyph_layer,\n", name);
+    fprintf(fp, "    %s_atlas,\n", name);
+    fprintf(fp, "    %d,\n", compressed_size);
+    // checked by mv_ef_init_baked(): mip levels, oversampling and height alignment
+    fprintf(fp, "    %d, %d, %d, %d\n", MV_EF_MIP_LEVELS, MV_EF_OVERSAMPLE_X, MV_EF_OVERSAMPLE_Y, mv_ef_atlas_height_alignment());
+    fprintf(fp, "};\n");
+
+    fclose(fp);
+    free(compressed);
+
+    printf("Wrote \"%s\": %d bytes of atlas, %.1f%% of the raw size\n", output_filename, compressed_size, 100.0*compressed_size/bitmap_size);
+
+    return 0;
+}
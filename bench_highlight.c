@@ -0,0 +1,400 @@
+//
+// Syntax highlighter benchmark
+//
+// Compares mv_ef_highlight_glsl() against the highlighter main.c used to have (color_string(), kept
+// below as the reference): checks that both give every byte the same color, and measures the throughput
+// of both in MB/s. Then measures mv_ef_highlight_glsl() alone on the source repeated up to 16 MB, and
+// mv_ef_glsl_stream on the same, fed to it in 64 KB blocks.
+//
+// Usage: ./bench_highlight [-n repetitions] [source.glsl]
+//
+// The source is extra/vertex_shader_text.vs by default. The reference keeps its tokens in a fixed array
+// of 9999, so it's only run on sources with fewer tokens than that.
+// The two differ on purpose where the reference was wrong: a name at the very end of the source was left
+// uncolored, "\r" counted as part of a name, and names like "info" or "nan" were numbers (sscanf)
+//
+// clock_gettime() is posix, which strict -std=c99 leaves out
+#if defined(__STRICT_ANSI__) && !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MV_EF_HIGHLIGHT_IMPLEMENTATION
+#include "mv_ef_highlight.h"
+
+#define LARGE_SIZE (16*1024*1024)
+#define STREAM_BLOCK_SIZE (64*1024)
+
+double time_ms()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return 1000.0*counter.QuadPart/frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000.0*ts.tv_sec + ts.tv_nsec/1.0e6;
+#endif
+}
+
+char *read_file(const char *filename, size_t *length)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *str = (char*)malloc(size + 1);
+    *length = fread(str, 1, size, fp);
+    str[*length] = '\0';
+    fclose(fp);
+    return str;
+}
+
+typedef enum Token_Type {TOKEN_OTHER=0, TOKEN_OPERATOR, TOKEN_NUMERIC, TOKEN_FUNCTION, TOKEN_KEYWORD, TOKEN_COMMENT, TOKEN_VARIABLE, TOKEN_UNSET} Token_Type;
+
+const char *TOKEN_NAMES[] = {"other", "operator", "numeric", "function", "keyword", "comment", "type", "unset"};
+const char *TYPES[] = {"void", "int", "float", "vec2", "vec3", "vec4", "sampler1D", "sampler2D"};
+const char *KEYWORDS[] = {"#version", "#define", "in", "out", "uniform", "layout", "return", "if", "else", "for", "while"};
+
+typedef struct Token 
+{
+    char *start;
+    char *stop;
+    Token_Type type;
+} Token;
+
+
+// the syntax highlighter main.c used before mv_ef_highlight.h, verbatim
+void color_string(char *str, char *col)
+{
+    // ignored characters
+    char delims[] = " ,(){}[];\t\n";
+    int num_delims = strlen(delims);
+
+    char operators[] = "/+-*<>=&|";
+    int num_operators = strlen(operators);
+
+    Token tokens[9999]; // hurr
+    int num_tokens = 0; // running counter
+
+    char *ptr = str;
+    while (*ptr) {
+        // skip delimiters
+        int is_delim = 0;
+        for (int i = 0; i < num_delims; i++) {
+            if (*ptr == delims[i]) {
+                is_delim = 1;
+                break;
+            }
+        }
+
+        if (is_delim == 1) {
+            ptr++;
+            continue;
+        }
+
+        // found a token!
+        char *start = ptr;
+
+        if (*ptr == '/' && *(ptr+1) == '/') {
+            // found a line comment, go to end of line or end of file
+            while (*ptr != '\n' && *ptr != '\0') {
+                ptr++;
+            }
+
+            tokens[num_tokens].start = start;
+            tokens[num_tokens].stop = ptr;
+            tokens[num_tokens].type = TOKEN_COMMENT;
+            num_tokens++;
+
+            ptr++;
+            continue;
+        }
+
+        if (*ptr == '/' && *(ptr+1) == '*') {
+            // found a block comment, go to end of line or end of file
+            while (!(*ptr == '*' && *(ptr+1) == '/') && *ptr != '\0') {
+                ptr++;
+            }
+            ptr++;
+
+            tokens[num_tokens].start = start;
+            tokens[num_tokens].stop = ptr+1;
+            tokens[num_tokens].type = TOKEN_COMMENT;
+            num_tokens++;
+
+            ptr++;
+            continue;
+        } 
+
+        // check if it's an operator
+        int is_operator = 0;
+        for (int i = 0; i < num_operators; i++) {
+            if (*ptr == operators[i]) {
+                is_operator = 1;
+                break;
+            }
+        }
+
+        if (is_operator == 1) {
+            tokens[num_tokens].start = start;
+            tokens[num_tokens].stop = ptr+1;
+            tokens[num_tokens].type = TOKEN_OPERATOR;
+            num_tokens++;
+            ptr++;
+            continue;
+        } 
+
+        // it's either a name, type, a keyword, a function, or an names separated by an operator without spaces
+        while (*ptr) {
+            // check whether it's an operator stuck between two names
+            int is_operator2 = 0;
+            for (int i = 0; i < num_operators; i++) {
+                if (*ptr == operators[i]) {
+                    is_operator2 = 1;
+                    break;
+                }
+            }
+
+            if (is_operator2 == 1) {
+                tokens[num_tokens].start = start;
+                tokens[num_tokens].stop = ptr;
+                tokens[num_tokens].type = TOKEN_UNSET;
+                num_tokens++;
+                break;
+            }
+
+            // otherwise go until we find the next delimiter
+            int is_delim2 = 0;
+            for (int i = 0; i < num_delims; i++) {
+                if (*ptr == delims[i]) {
+                    is_delim2 = 1;
+                    break;
+                }
+            }
+
+            if (is_delim2 == 1) {
+                tokens[num_tokens].start = start;
+                tokens[num_tokens].stop = ptr;
+                tokens[num_tokens].type = TOKEN_UNSET;
+                num_tokens++;
+                ptr++;
+                break;
+            } 
+
+            // did not find delimiter, check next char
+            ptr++; 
+        }
+    }
+
+    // determine the types of the unset tokens, i.e. either
+    // a name, a type, a keyword, or a function
+    int num_keywords = sizeof(KEYWORDS)/sizeof(char*);
+    int num_types = sizeof(TYPES)/sizeof(char*);
+
+    for (int i = 0; i < num_tokens; i++) {
+        // TOKEN_OPERATOR and TOKEN_COMMENT should already be set, so skip those
+        if (tokens[i].type != TOKEN_UNSET) {
+            continue;
+        }
+
+        char end_char = *tokens[i].stop;
+
+        // temporarily null terminate at end of token, restored after parsing
+        *tokens[i].stop = '\0';
+
+        // parse
+        
+        // if it's a keyword
+        int is_keyword = 0;
+        for (int j = 0; j < num_keywords; j++) {
+            if (strcmp(tokens[i].start, KEYWORDS[j]) == 0) {
+                is_keyword = 1;
+                break;
+            }
+        }
+        if (is_keyword == 1) {
+            tokens[i].type = TOKEN_KEYWORD;
+            *tokens[i].stop = end_char;
+            continue;
+        } 
+
+        // Check if it's a function
+        float f;
+        if (end_char == '(') {
+            tokens[i].type = TOKEN_FUNCTION;
+            *tokens[i].stop = end_char;
+            continue;
+        } 
+
+        // or if it's a numeric value. catches both integers and floats
+        if (sscanf(tokens[i].start, "%f", &f) == 1) {
+            tokens[i].type = TOKEN_NUMERIC;
+            *tokens[i].stop = end_char;
+            continue;
+        } 
+
+        // if it's a variable type
+        int is_type = 0;
+        for (int j = 0; j < num_types; j++) {
+            if (strcmp(tokens[i].start, TYPES[j]) == 0) {
+                is_type = 1;
+                break;
+            }
+        }
+        if (is_type == 1) {
+            tokens[i].type = TOKEN_VARIABLE;
+            *tokens[i].stop = end_char;
+            continue;
+        } 
+
+        // otherwise it's a regular variable name 
+        tokens[i].type = TOKEN_OTHER;
+        *tokens[i].stop = end_char;
+    }
+    
+    // print all tokens and their types
+    for (int i = 0; i < num_tokens; i++) {
+
+        for (char *p = tokens[i].start; p != tokens[i].stop; p++) {
+            col[(p - str)] = tokens[i].type;
+        }
+    }
+}
+
+
+// consumes the output, so the highlighting isn't optimized away
+static volatile unsigned int sink;
+
+int main(int argc, char *argv[])
+{
+    const char *filename = "extra/vertex_shader_text.vs";
+    int repetitions = 2000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i+1 < argc)
+            repetitions = atoi(argv[++i]);
+        else if (argv[i][0] != '-')
+            filename = argv[i];
+        else {
+            printf("Usage: %s [-n repetitions] [source.glsl]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repetitions <= 0)
+        repetitions = 1;
+
+    size_t length;
+    char *str = read_file(filename, &length);
+    if (!str || length == 0) {
+        printf("Error: could not read \"%s\"\n", filename);
+        return 1;
+    }
+    // the reference stops at the first NUL
+    length = strlen(str);
+
+    size_t num_tokens = 0, pos = 0;
+    mv_ef_token token;
+    while (mv_ef_glsl_next_token(str, length, &pos, &token))
+        num_tokens++;
+    printf("\"%s\": %zu bytes, %zu tokens\n", filename, length, num_tokens);
+
+    char *col = (char*)malloc(length);
+    double mb = length/(1024.0*1024.0);
+
+    double t0 = time_ms();
+    for (int i = 0; i < repetitions; i++) {
+        mv_ef_highlight_glsl(str, length, col);
+        sink += col[i % length];
+    }
+    double new_ms = (time_ms() - t0)/repetitions;
+    printf("mv_ef_highlight_glsl: %8.3f us, %8.1f MB/s\n", 1000.0*new_ms, mb/(new_ms/1000.0));
+
+    if (num_tokens < 9000) {
+        char *ref_col = (char*)malloc(length);
+        t0 = time_ms();
+        for (int i = 0; i < repetitions; i++) {
+            memset(ref_col, 0, length);
+            color_string(str, ref_col);
+            sink += ref_col[i % length];
+        }
+        double ref_ms = (time_ms() - t0)/repetitions;
+        printf("color_string:         %8.3f us, %8.1f MB/s\n", 1000.0*ref_ms, mb/(ref_ms/1000.0));
+        printf("speedup: %.1fx\n", ref_ms/new_ms);
+
+        size_t mismatches = 0, first = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (col[i] != ref_col[i] && mismatches++ == 0)
+                first = i;
+        }
+        if (mismatches)
+            printf("%zu byte(s) colored differently, the first at byte %zu (%s instead of %s)\n", mismatches, first,
+                   mv_ef_token_names[(int)col[first]], mv_ef_token_names[(int)ref_col[first]]);
+        else
+            printf("identical colors\n");
+        free(ref_col);
+    } else {
+        printf("too many tokens for the reference, skipping it\n");
+    }
+
+    // the source repeated, with a line break in between so names don't merge
+    size_t large_length = 0;
+    char *large = (char*)malloc(LARGE_SIZE);
+    while (large_length + length + 1 <= LARGE_SIZE) {
+        memcpy(large + large_length, str, length);
+        large_length += length;
+        large[large_length++] = '\n';
+    }
+    if (large_length > 0) {
+        char *large_col = (char*)malloc(large_length);
+        int large_repetitions = 1 + (int)(repetitions*(double)length/large_length);
+        t0 = time_ms();
+        for (int i = 0; i < large_repetitions; i++) {
+            mv_ef_highlight_glsl(large, large_length, large_col);
+            sink += large_col[i % large_length];
+        }
+        double large_ms = (time_ms() - t0)/large_repetitions;
+        printf("mv_ef_highlight_glsl on %.1f MB: %.2f ms, %.1f MB/s\n", large_length/(1024.0*1024.0), large_ms,
+               large_length/(1024.0*1024.0)/(large_ms/1000.0));
+
+        // the same, fed to a stream a block at a time, as if read from a file
+        char *stream_col = (char*)malloc(large_length);
+        t0 = time_ms();
+        for (int i = 0; i < large_repetitions; i++) {
+            mv_ef_glsl_stream stream;
+            mv_ef_glsl_stream_begin(&stream, stream_col, NULL, 0);
+            for (size_t offset = 0; offset < large_length; offset += STREAM_BLOCK_SIZE) {
+                size_t n = large_length - offset < STREAM_BLOCK_SIZE ? large_length - offset : STREAM_BLOCK_SIZE;
+                mv_ef_glsl_stream_feed(&stream, large + offset, n);
+            }
+            mv_ef_glsl_stream_end(&stream);
+            sink += stream_col[i % large_length];
+        }
+        double stream_ms = (time_ms() - t0)/large_repetitions;
+        printf("mv_ef_glsl_stream in %d KB blocks: %.2f ms, %.1f MB/s, %s\n", STREAM_BLOCK_SIZE/1024, stream_ms,
+               large_length/(1024.0*1024.0)/(stream_ms/1000.0),
+               memcmp(stream_col, large_col, large_length) ? "colors differ" : "identical colors");
+
+        free(stream_col);
+        free(large_col);
+    }
+
+    free(large);
+    free(col);
+    free(str);
+    return 0;
+}
@@ -0,0 +1,332 @@
+//
+// Startup latency benchmark
+//
+// Times every phase of mv_ef_init() (see the init_*_ms fields of mv_ef_font) for a set of fonts and
+// sizes, both with a cold cache (no atlas cache and no program binary) and a warm one, and writes the
+// medians and minimums as JSON, so startup regressions show up when comparing two runs.
+//
+// Usage: ./bench_startup [-o output.json] [-n repetitions] [font.ttf ...]
+//
+// Without font arguments it uses whichever of a few common fonts it finds. Runs in a hidden glfw window.
+// The cache goes to a private directory that is emptied before every cold run, and the driver's own
+// shader cache is disabled (mesa, nvidia), so cold runs really compile the shaders. The font files
+// themselves stay in the OS page cache, so "cold" means a cold mv_easy_font cache, not a cold disk.
+//
+// setenv(), the directory functions and realpath() in mv_easy_font.h are posix, which strict -std=c99 leaves out
+#if defined(__STRICT_ANSI__) && !defined(_WIN32) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE)
+#define _XOPEN_SOURCE 700
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include <glad/glad.h>
+#include <glad/glad.c>
+#include <GLFW/glfw3.h>
+
+// the cache directory is a variable, so it can be emptied between cold runs
+static char bench_cache_dir[512] = "bench_startup_cache";
+#define MV_EF_CACHE_DIR bench_cache_dir
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+#define MV_EF_GET_PROC_ADDRESS glfwGetProcAddress
+#define MV_EASY_FONT_IMPLEMENTATION
+#include "mv_easy_font.h"
+
+#define MAX_REPETITIONS 64
+
+typedef enum { PHASE_OPEN, PHASE_CACHE, PHASE_RASTER, PHASE_METRICS, PHASE_SHADER, PHASE_UPLOAD, PHASE_FINISH, PHASE_TOTAL, NUM_PHASES } Phase;
+const char *PHASE_NAMES[NUM_PHASES] = {"open_ms", "cache_ms", "raster_ms", "metrics_ms", "shader_ms", "upload_ms", "gl_finish_ms", "total_ms"};
+
+// empties the cache directory, or creates it
+void clear_cache_dir()
+{
+#if defined(_WIN32)
+    _mkdir(bench_cache_dir);
+
+    char pattern[600];
+    snprintf(pattern, sizeof(pattern), "%s/*", bench_cache_dir);
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA(pattern, &data);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            char path[sizeof(bench_cache_dir) + sizeof(data.cFileName)];
+            snprintf(path, sizeof(path), "%s/%s", bench_cache_dir, data.cFileName);
+            DeleteFileA(path);
+        }
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    mkdir(bench_cache_dir, 0755);
+
+    DIR *dir = opendir(bench_cache_dir);
+    if (!dir)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        char path[sizeof(bench_cache_dir) + sizeof(entry->d_name)]; // room for the longest of both
+        snprintf(path, sizeof(path), "%s/%s", bench_cache_dir, entry->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+#endif
+}
+
+// throws away everything mv_ef_init() created, so the next run starts from scratch
+void release_font()
+{
+    mv_ef_destroy_context(mv_ef_default_context());
+    glFinish();
+}
+
+// one full initialization, with glFinish() to include the work the driver deferred
+void run_init(const char *filename, int size, double *phases, int *cache_hit)
+{
+    double t0 = mv_ef_time_ms();
+    mv_ef_init((char*)filename, size, NULL, NULL);
+    double t1 = mv_ef_time_ms();
+    glFinish();
+    double t2 = mv_ef_time_ms();
+
+    mv_ef_font *f = mv_ef_get_font();
+    phases[PHASE_OPEN] = f->init_open_ms;
+    phases[PHASE_CACHE] = f->init_cache_ms;
+    phases[PHASE_RASTER] = f->init_raster_ms;
+    phases[PHASE_METRICS] = f->init_metrics_ms;
+    phases[PHASE_SHADER] = f->init_shader_ms;
+    phases[PHASE_UPLOAD] = f->init_upload_ms;
+    phases[PHASE_FINISH] = t2 - t1;
+    phases[PHASE_TOTAL] = t2 - t0;
+    *cache_hit = f->init_cache_hit;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// json string, with the characters that need it escaped
+void write_json_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', fp);
+        if ((unsigned char)*s >= 32)
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+// runs one font at one size with a cold or warm cache, and writes the result as a json object
+void bench(FILE *fp, const char *filename, int size, int warm, int repetitions)
+{
+    static double samples[NUM_PHASES][MAX_REPETITIONS];
+    int cache_hits = 0;
+
+    // a warm cache needs one run to fill it
+    if (warm) {
+        clear_cache_dir();
+        double phases[NUM_PHASES];
+        int hit;
+        run_init(filename, size, phases, &hit);
+        release_font();
+    }
+
+    for (int i = 0; i < repetitions; i++) {
+        if (!warm)
+            clear_cache_dir();
+
+        double phases[NUM_PHASES];
+        int hit;
+        run_init(filename, size, phases, &hit);
+        for (int j = 0; j < NUM_PHASES; j++)
+            samples[j][i] = phases[j];
+        cache_hits += hit;
+
+        if (i < repetitions-1)
+            release_font();
+    }
+
+    mv_ef_font *f = mv_ef_get_font();
+    fprintf(fp, "    {\"font\": ");
+    write_json_string(fp, filename);
+    fprintf(fp, ", \"size\": %d, \"cache\": \"%s\", \"cache_hits\": %d, ", size, warm ? "warm" : "cold", cache_hits);
+    fprintf(fp, "\"atlas\": [%d, %d, %d], \"arena_bytes\": %lu,\n", f->width, f->height, f->num_pages, (unsigned long)f->init_arena_used);
+    release_font();
+
+    for (int k = 0; k < 2; k++) {
+        fprintf(fp, "     \"%s\": {", k == 0 ? "median" : "min");
+        for (int j = 0; j < NUM_PHASES; j++) {
+            qsort(samples[j], repetitions, sizeof(double), compare_doubles);
+            double v = k == 0 ? samples[j][repetitions/2] : samples[j][0];
+            fprintf(fp, "%s\"%s\": %.3f", j ? ", " : "", PHASE_NAMES[j], v);
+        }
+        fprintf(fp, "}%s\n", k == 0 ? "," : "");
+    }
+    fprintf(fp, "    }");
+
+    printf("%-50s %3dpx %s: %8.2f ms (raster %.2f, shader %.2f, upload %.2f)\n", filename, size, warm ? "warm" : "cold",
+           samples[PHASE_TOTAL][repetitions/2], samples[PHASE_RASTER][repetitions/2], samples[PHASE_SHADER][repetitions/2],
+           samples[PHASE_UPLOAD][repetitions/2]);
+    fflush(stdout);
+}
+
+int file_exists(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp)
+        fclose(fp);
+    return fp != NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_filename = "bench_startup.json";
+    int repetitions = 5;
+
+    const char *default_fonts[] = {
+        "extra/Inconsolata-Regular.ttf",
+        "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+        "/usr/share/fonts/truetype/dejavu/DejaVuSerif.ttf",
+        "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+        "/usr/share/fonts/dejavu/DejaVuSerif.ttf",
+        "C:/Windows/Fonts/consola.ttf",
+        "C:/Windows/Fonts/arial.ttf",
+        "C:/Windows/Fonts/times.ttf",
+    };
+    int sizes[] = {8, 12, 16, 24, 32, 48, 64, 96, 128};
+    int num_sizes = sizeof(sizes)/sizeof(sizes[0]);
+
+    const char *fonts[64];
+    int num_fonts = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            output_filename = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (num_fonts < 64) {
+            fonts[num_fonts++] = argv[i];
+        }
+    }
+
+    if (repetitions < 1 || repetitions > MAX_REPETITIONS) {
+        printf("Error: the number of repetitions has to be between 1 and %d\n", MAX_REPETITIONS);
+        return 1;
+    }
+
+    if (num_fonts == 0) {
+        for (int i = 0; i < (int)(sizeof(default_fonts)/sizeof(default_fonts[0])); i++)
+            if (file_exists(default_fonts[i]))
+                fonts[num_fonts++] = default_fonts[i];
+    }
+    for (int i = 0; i < num_fonts; i++) {
+        if (!file_exists(fonts[i])) {
+            printf("Error: could not open \"%s\"\n", fonts[i]);
+            return 1;
+        }
+    }
+    if (num_fonts == 0) {
+        printf("Error: no fonts found, pass some .ttf files\n");
+        return 1;
+    }
+
+    // keep the driver from caching compiled shaders behind our back
+#if defined(_WIN32)
+    _putenv("__GL_SHADER_DISK_CACHE=0");
+    _putenv("MESA_SHADER_CACHE_DISABLE=true");
+#else
+    setenv("__GL_SHADER_DISK_CACHE", "0", 1);
+    setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+#endif
+
+    if (!glfwInit()) {
+        printf("Error: could not initialize glfw\n");
+        return 1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    GLFWwindow *window = glfwCreateWindow(64, 64, "bench_startup", 0, 0);
+    if (!window) {
+        printf("Error: could not create a glfw window\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGL()) {
+        printf("Error: could not load opengl\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    FILE *fp = fopen(output_filename, "w");
+    if (!fp) {
+        printf("Error: could not open \"%s\" for writing\n", output_filename);
+        glfwTerminate();
+        return 1;
+    }
+
+    fprintf(fp, "{\n  \"gl_vendor\": ");
+    write_json_string(fp, (const char*)glGetString(GL_VENDOR));
+    fprintf(fp, ",\n  \"gl_renderer\": ");
+    write_json_string(fp, (const char*)glGetString(GL_RENDERER));
+    fprintf(fp, ",\n  \"gl_version\": ");
+    write_json_string(fp, (const char*)glGetString(GL_VERSION));
+    fprintf(fp, ",\n  \"repetitions\": %d,\n", repetitions);
+
+    int compressed = 0, threads = MV_EF_MAX_THREADS;
+#ifdef MV_EF_COMPRESS_ATLAS
+    compressed = 1;
+#endif
+#ifdef MV_EF_NO_THREADS
+    threads = 1;
+#endif
+    fprintf(fp, "  \"config\": {\"mip_levels\": %d, \"oversample\": [%d, %d], \"compress_atlas\": %d, \"max_threads\": %d},\n",
+            MV_EF_MIP_LEVELS, MV_EF_OVERSAMPLE_X, MV_EF_OVERSAMPLE_Y, compressed, threads);
+    fprintf(fp, "  \"results\": [\n");
+
+    int first = 1;
+    for (int i = 0; i < num_fonts; i++) {
+        for (int j = 0; j < num_sizes; j++) {
+            for (int warm = 0; warm < 2; warm++) {
+                if (!first)
+                    fprintf(fp, ",\n");
+                first = 0;
+                bench(fp, fonts[i], sizes[j], warm, repetitions);
+            }
+        }
+    }
+
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+
+    clear_cache_dir();
+    glfwTerminate();
+
+    printf("Wrote \"%s\"\n", output_filename);
+    return 0;
+}
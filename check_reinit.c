@@ -0,0 +1,177 @@
+//
+// Re-initialization check
+//
+// Initializes a headless context several times in a row, baking the atlas the first two times and mapping
+// it from the atlas cache after that, and then destroys it. Checks that every initialization released
+// what the one before it loaded: the heap atlas, the mapped cache file and the font file.
+// Counts live allocations through the allocator hooks and, on linux, the mapped files in /proc/self/maps.
+// Exits with 1 if anything is left over, so it can run in CI on machines without a gpu.
+//
+// Usage: ./check_reinit [-n inits]
+//
+// Run it from the root of the repository. The cache goes to check_reinit_cache/, which is emptied first.
+// On other systems than linux only the allocations are checked
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+// every allocation of the library goes through these
+static long live_allocations = 0;
+
+void *check_malloc(size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr)
+        live_allocations++;
+    return ptr;
+}
+
+void *check_realloc(void *ptr, size_t size)
+{
+    void *result = realloc(ptr, size);
+    if (!ptr && result)
+        live_allocations++;
+    return result;
+}
+
+void check_free(void *ptr)
+{
+    if (ptr)
+        live_allocations--;
+    free(ptr);
+}
+
+#define MV_EF_MALLOC(size)       check_malloc(size)
+#define MV_EF_REALLOC(ptr, size) check_realloc(ptr, size)
+#define MV_EF_FREE(ptr)          check_free(ptr)
+
+#include <glad/glad.h>
+#include <glad/glad.c>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+static char check_cache_dir[] = "check_reinit_cache";
+#define MV_EF_CACHE_DIR check_cache_dir
+#define MV_EASY_FONT_IMPLEMENTATION
+#include "mv_easy_font.h"
+
+// empties the cache directory, or creates it
+void clear_cache_dir()
+{
+#if defined(_WIN32)
+    _mkdir(check_cache_dir);
+
+    char pattern[600];
+    snprintf(pattern, sizeof(pattern), "%s/*", check_cache_dir);
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA(pattern, &data);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            char path[sizeof(check_cache_dir) + sizeof(data.cFileName)];
+            snprintf(path, sizeof(path), "%s/%s", check_cache_dir, data.cFileName);
+            DeleteFileA(path);
+        }
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    mkdir(check_cache_dir, 0755);
+
+    DIR *dir = opendir(check_cache_dir);
+    if (!dir)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        char path[sizeof(check_cache_dir) + sizeof(entry->d_name)];
+        snprintf(path, sizeof(path), "%s/%s", check_cache_dir, entry->d_name);
+        unlink(path);
+    }
+    closedir(dir);
+#endif
+}
+
+// number of mappings of files whose path contains name, -1 where that can't be told
+int count_mappings(const char *name)
+{
+#if defined(__linux__)
+    FILE *fp = fopen("/proc/self/maps", "r");
+    if (!fp)
+        return -1;
+    int count = 0;
+    char line[4096];
+    while (fgets(line, sizeof(line), fp))
+        count += strstr(line, name) != NULL;
+    fclose(fp);
+    return count;
+#else
+    (void)name;
+    return -1;
+#endif
+}
+
+// prints what is still loaded, returns 0 if it's more than expected
+int check_loaded(const char *when, long max_allocations, int max_cache_mappings, int max_font_mappings)
+{
+    int cache_mappings = count_mappings(check_cache_dir);
+    int font_mappings = count_mappings("Inconsolata-Regular.ttf");
+    int ok = live_allocations <= max_allocations && cache_mappings <= max_cache_mappings && font_mappings <= max_font_mappings;
+    printf("%s: %ld allocations, %d cache file mappings, %d font file mappings: %s\n", when, live_allocations,
+           cache_mappings, font_mappings, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_inits = 4;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i+1 < argc)
+            num_inits = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [-n inits]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_inits < 4)
+        num_inits = 4;
+
+    mv_ef_context *ctx = mv_ef_default_context();
+
+    int passed = 1;
+    long bake_allocations = 0, hit_allocations = 0;
+    for (int i = 0; i < num_inits; i++) {
+        // from an empty cache the first two times, so they bake and the others hit
+        if (i < 2)
+            clear_cache_dir();
+        if (!mv_ef_ctx_init_headless(ctx, (char*)"extra/Inconsolata-Regular.ttf", 0, 48)) {
+            printf("Error: could not load extra/Inconsolata-Regular.ttf\n");
+            return 1;
+        }
+
+        char when[64];
+        snprintf(when, sizeof(when), "init %d (cache %s)", i+1, ctx->font.init_cache_hit ? "hit" : "miss");
+        // every bake holds as much as the first one, and every cache hit as much as the first hit
+        if (i == 0)
+            bake_allocations = live_allocations;
+        if (i == 2)
+            hit_allocations = live_allocations;
+        passed &= check_loaded(when, i < 2 ? bake_allocations : hit_allocations, 1, 1);
+    }
+
+    mv_ef_destroy_context(ctx);
+    passed &= check_loaded("destroyed", 0, 0, 0);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+//
+// Software renderer check
+//
+// Renders a fixed page of text with mv_ef_draw_cpu(), headless and with the bundled Inconsolata, into an
+// RGBA and an A8 framebuffer, and compares both with the images checked in as extra/check_render.pam and
+// extra/check_render.pgm. Exits with 1 if any channel of any pixel is off by more than max_difference
+// (2 levels by default), so it can run in CI on machines without a gpu.
+//
+// Usage: ./check_render [-t max_difference] [-w]
+//
+// Run it from the root of the repository. -w writes the rendered images as the new reference, after a
+// change to the rasterizer that is meant to change its output. The reference is only valid for the
+// default settings of mv_easy_font.h, e.g. MV_EF_OVERSAMPLE_X/Y change every glyph. The SSE2 and scalar
+// blends, and compilers that fuse multiply-adds, can round a level apart, hence the tolerance
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+#include <glad/glad.c>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+// don't read or leave an atlas cache behind on the ci machine
+#define MV_EF_NO_CACHE
+#define MV_EASY_FONT_IMPLEMENTATION
+#include "mv_easy_font.h"
+
+#define CHECK_WIDTH 320
+#define CHECK_HEIGHT 160
+
+// text, colors and size of each block of the page, from the top: minified, heavily minified and at the size of the atlas
+typedef struct {
+    const char *text;
+    const char *col;
+    float size;
+    float offset[2];
+} check_block;
+
+static const check_block check_blocks[] = {
+    {"void main() {\n    gl_Position = vec4(pos, 0.0, 1.0);\n}",
+     "444400000111100000333333333330104444100011222112221111", 16.0f, {6.0f, -4.0f}},
+    {"The quick brown fox jumps over the lazy dog\n0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~",
+     NULL, 7.0f, {6.0f, -66.0f}},
+    {"Ag&@{}", "012345", 48.0f, {6.0f, -92.0f}},
+};
+
+// draws the page into fb, cleared to background first
+void render_page(mv_ef_framebuffer *fb, const unsigned char *background)
+{
+    for (int y = 0; y < fb->height; y++)
+        for (int x = 0; x < fb->width; x++)
+            memcpy(fb->pixels + y*fb->stride + x*fb->channels, background, fb->channels);
+
+    for (int i = 0; i < (int)(sizeof(check_blocks)/sizeof(check_blocks[0])); i++) {
+        const check_block *b = &check_blocks[i];
+        float offset[2] = {b->offset[0], b->offset[1]};
+        mv_ef_draw_cpu(fb, (char*)b->text, (char*)b->col, offset, b->size);
+    }
+}
+
+// P7 (PAM) for RGBA, P5 (PGM) for A8
+int write_image(const char *path, const mv_ef_framebuffer *fb)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        printf("Error: could not write \"%s\"\n", path);
+        return 0;
+    }
+    if (fb->channels == 4)
+        fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", fb->width, fb->height);
+    else
+        fprintf(fp, "P5\n%d %d\n255\n", fb->width, fb->height);
+    for (int y = 0; y < fb->height; y++)
+        fwrite(fb->pixels + y*fb->stride, 1, fb->width*fb->channels, fp);
+    fclose(fp);
+    return 1;
+}
+
+// reads an image written by write_image(), returns NULL if it's missing or not channels deep
+unsigned char *read_image(const char *path, int width, int height, int channels)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        printf("Error: could not open \"%s\", run with -w to write it\n", path);
+        return NULL;
+    }
+
+    int w = 0, h = 0, depth = 1, maxval = 0, ok;
+    if (channels == 4)
+        ok = fscanf(fp, "P7 WIDTH %d HEIGHT %d DEPTH %d MAXVAL %d TUPLTYPE RGB_ALPHA ENDHDR", &w, &h, &depth, &maxval) == 4;
+    else
+        ok = fscanf(fp, "P5 %d %d %d", &w, &h, &maxval) == 3;
+    ok = ok && fgetc(fp) == '\n' && w == width && h == height && depth == channels && maxval == 255;
+
+    unsigned char *pixels = (unsigned char*)malloc((size_t)width*height*channels);
+    if (!ok || fread(pixels, 1, (size_t)width*height*channels, fp) != (size_t)width*height*channels) {
+        printf("Error: \"%s\" is not a %dx%d image with %d channel(s)\n", path, width, height, channels);
+        free(pixels);
+        pixels = NULL;
+    }
+    fclose(fp);
+    return pixels;
+}
+
+// prints how far fb is from the reference, returns 1 if no channel is off by more than max_difference
+int compare_image(const char *name, const mv_ef_framebuffer *fb, const unsigned char *reference, int max_difference)
+{
+    int max_diff = 0, num_off = 0;
+    for (int y = 0; y < fb->height; y++) {
+        for (int x = 0; x < fb->width; x++) {
+            int pixel_diff = 0;
+            for (int c = 0; c < fb->channels; c++) {
+                int i = (y*fb->width + x)*fb->channels + c;
+                int d = abs(fb->pixels[y*fb->stride + x*fb->channels + c] - reference[i]);
+                if (d > pixel_diff)
+                    pixel_diff = d;
+            }
+            if (pixel_diff > max_diff)
+                max_diff = pixel_diff;
+            if (pixel_diff > max_difference)
+                num_off++;
+        }
+    }
+
+    printf("%s: max difference %d, %d pixels off by more than %d: %s\n", name, max_diff, num_off, max_difference,
+           num_off ? "FAILED" : "ok");
+    return num_off == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_difference = 2;
+    int write = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i+1 < argc)
+            max_difference = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w"))
+            write = 1;
+        else {
+            printf("Usage: %s [-t max_difference] [-w]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!mv_ef_init_headless((char*)"extra/Inconsolata-Regular.ttf", 48)) {
+        printf("Error: could not load extra/Inconsolata-Regular.ttf\n");
+        return 1;
+    }
+
+    // the background of the example program
+    unsigned char rgba_background[4] = {39, 40, 34, 255};
+    unsigned char a8_background[1] = {0};
+
+    static unsigned char rgba_pixels[4*CHECK_WIDTH*CHECK_HEIGHT];
+    static unsigned char a8_pixels[CHECK_WIDTH*CHECK_HEIGHT];
+    mv_ef_framebuffer rgba = {rgba_pixels, CHECK_WIDTH, CHECK_HEIGHT, 4*CHECK_WIDTH, 4};
+    mv_ef_framebuffer a8 = {a8_pixels, CHECK_WIDTH, CHECK_HEIGHT, CHECK_WIDTH, 1};
+    render_page(&rgba, rgba_background);
+    render_page(&a8, a8_background);
+
+    const char *rgba_path = "extra/check_render.pam";
+    const char *a8_path = "extra/check_render.pgm";
+
+    int passed = 1;
+    if (write) {
+        passed = write_image(rgba_path, &rgba) && write_image(a8_path, &a8);
+        if (passed)
+            printf("Wrote %s and %s\n", rgba_path, a8_path);
+    } else {
+        unsigned char *rgba_reference = read_image(rgba_path, CHECK_WIDTH, CHECK_HEIGHT, 4);
+        unsigned char *a8_reference = read_image(a8_path, CHECK_WIDTH, CHECK_HEIGHT, 1);
+        passed = rgba_reference && a8_reference;
+        if (passed) {
+            passed &= compare_image("rgba", &rgba, rgba_reference, max_difference);
+            passed &= compare_image("a8", &a8, a8_reference, max_difference);
+        }
+        free(rgba_reference);
+        free(a8_reference);
+    }
+
+    mv_ef_destroy_context(mv_ef_default_context());
+    return passed ? 0 : 1;
+}
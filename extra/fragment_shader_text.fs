@@ -1,9 +1,9 @@
 #version 330 core
 
-in vec2 uv;
+in vec3 uv;
 in float color_index;
 
-uniform sampler2D sampler_font;
+uniform sampler2DArray sampler_font;
 uniform sampler1D sampler_colors;
 uniform float num_colors;
 
@@ -2,41 +2,65 @@
 
 layout(location = 0) in vec2 vertexPosition;
 layout(location = 1) in vec4 instanceGlyph;
+layout(location = 2) in float instanceScale; // per glyph scale_factor multiplier, 1.0 except for labels
+layout(location = 3) in float instanceLabel; // index into sampler_world, for world space labels
 
-uniform sampler2D sampler_font;
+uniform sampler2DArray sampler_font;
 uniform sampler2D sampler_meta;
+uniform samplerBuffer sampler_world; // model matrix and billboard flag of every world space label
+
+layout(std140) uniform mv_ef_world {
+    mat4 view_projection;
+};
+uniform float world_space;      // 1.0 to place the text with sampler_world and view_projection instead
 
 uniform float offset_firstline; // ascent - descent - linegap/2
 uniform float scale_factor;     // scaling factor proportional to font size
 uniform vec2 string_offset;     // offset of upper-left corner
 
-uniform vec2 res_meta;   // 96x2 
-uniform vec2 res_bitmap; // 512x256
+uniform vec2 res_meta;   // MV_EF_MAX_GLYPHS x 3 
+uniform vec2 res_bitmap; // size of an atlas page
 uniform vec2 resolution; // screen resolution
 
-out vec2 uv;
+out vec3 uv;           // (u, v, layer) in the atlas
 out float color_index; // for syntax highlighting
 
 void main()
 {
     // (xoff, yoff, xoff2, yoff2), from second row of texture
-    vec4 q2 = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.75))*vec4(res_bitmap, res_bitmap);
+    vec4 q2 = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 1.5/res_meta.y))*vec4(res_bitmap, res_bitmap);
     
     vec2 p = vertexPosition*(q2.zw - q2.xy) + q2.xy; // offset and scale it properly relative to baseline
     p *= vec2(1.0, -1.0);                            // flip y, since texture is upside-down
     p.y -= offset_firstline;                         // make sure the upper-left corner of the string is in the upper-left corner of the screen
-    p *= scale_factor;                               // scale relative to font size
+    p *= scale_factor*instanceScale;                 // scale relative to font size
     p += instanceGlyph.xy + string_offset;           // move glyph into the right position
-    p *= 2.0/resolution;                             // to NDC
-    p += vec2(-1.0, 1.0);                            // move to upper-left corner instead of center
-    
-    gl_Position = vec4(p, 0.0, 1.0);
+
+    if (world_space > 0.5) {
+        // p is in the plane of the label
+        int label = 5*int(instanceLabel);
+        mat4 model = mat4(texelFetch(sampler_world, label), texelFetch(sampler_world, label + 1),
+                          texelFetch(sampler_world, label + 2), texelFetch(sampler_world, label + 3));
+        if (texelFetch(sampler_world, label + 4).x > 0.5) {
+            gl_Position = view_projection*model[3];            // billboard, projected origin
+            gl_Position.xy += p*2.0/resolution*gl_Position.w; // plus pixels on the screen
+        } else {
+            gl_Position = view_projection*(model*vec4(p, 0.0, 1.0));
+        }
+    } else {
+        p *= 2.0/resolution;                         // to NDC
+        p += vec2(-1.0, 1.0);                        // move to upper-left corner instead of center
+        gl_Position = vec4(p, 0.0, 1.0);
+    }
 
     // (x0, y0, x1-x0, y1-y0), from first row of texture
-    vec4 q = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.25));
+    vec4 q = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.5/res_meta.y));
+
+    // atlas layer, from third row of texture
+    float layer = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 2.5/res_meta.y)).x;
 
     // send the correct uv's in the font atlas to the fragment shader
-    uv = q.xy + vertexPosition*q.zw;
+    uv = vec3(q.xy + vertexPosition*q.zw, layer);
     color_index = instanceGlyph.w;
 }
 
@@ -1,9 +1,34 @@
 #ifndef MV_EASY_FONT_H
 #define MV_EASY_FONT_H
 
+// the implementation uses posix (clock_gettime, realpath, st_mtim), which strict -std=c99 leaves out.
+// only takes effect when this file comes before any system header, otherwise those fall back to plain c
+#if defined(MV_EASY_FONT_IMPLEMENTATION) && defined(__STRICT_ANSI__) && !defined(_WIN32) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE) && !defined(_GNU_SOURCE)
+#define _XOPEN_SOURCE 700
+#endif
+
+// allocator hooks, used for everything mv_easy_font allocates. define all three before including this file
+#ifndef MV_EF_MALLOC
+#include <stdlib.h>
+#define MV_EF_MALLOC(size)       malloc(size)
+#define MV_EF_REALLOC(ptr, size) realloc(ptr, size)
+#define MV_EF_FREE(ptr)          free(ptr)
+#endif
+
+// stb_truetype allocates through the hooks as well, and from the init arena while the atlas is baked. 
+// only takes effect when this file is included before the stb_truetype.h implementation, 
+// and the program hasn't defined its own STBTT_malloc
+#ifndef STBTT_malloc
+#define STBTT_malloc(x,u) mv_ef_stbtt_malloc(x,u)
+#define STBTT_free(x,u)   mv_ef_stbtt_free(x,u)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
+void *mv_ef_stbtt_malloc(size_t size, void *userdata);
+void mv_ef_stbtt_free(void *ptr, void *userdata);
+
 // utility functions to load shaders
 char *mv_ef_read_entire_file(const char *filename);
 GLuint mv_ef_load_shaders(const char *vs_path, const char *fs_path);
@@ -11,23 +36,88 @@ GLuint mv_ef_load_shaders(const char *vs_path, const char *fs_path);
 #define MAX_STRING_LEN 40000 // more glyphs than any reasonable person would show on the screen at once. you can only fit 20736 10x10 rects in a 1920x1080 window
 #define NUM_GLYPHS 96
 
+// total number of glyphs, the first NUM_GLYPHS (ascii 32-127) baked at init and the rest added on demand.
+// this is the width of the metadata texture, so keep it within GL_MAX_TEXTURE_SIZE
+#ifndef MV_EF_MAX_GLYPHS
+#define MV_EF_MAX_GLYPHS 1024
+#endif
+
+#ifndef MV_EF_MAX_FALLBACKS
+#define MV_EF_MAX_FALLBACKS 8
+#endif
+
+//
+// Which codepoints a font has, as a two-level bitmap over all of unicode. 
+// top[] has one entry per 256 codepoints, pointing at a 256-bit block in blocks. 
+// block 0 is all zeros and block 1 all ones, and identical blocks are shared
+//
+typedef struct {
+    unsigned short top[0x110000 >> 8];
+    int num_blocks;
+    unsigned char *blocks; // num_blocks*32 bytes
+} mv_ef_coverage;
+
+// a font for the codepoints the main font doesn't have
+typedef struct {
+    char filename[256];
+    const unsigned char *ttf_data;
+    size_t ttf_size;
+    stbtt_fontinfo info;
+    mv_ef_coverage *coverage; // built on first use
+} mv_ef_fallback_font;
+
 //
 // Struct containing font info and OpenGL variables for vbos, vao and textures
 //
 typedef struct {
     int initialized; // to be able to initialize from the first call to mv_ef_draw()
+    int ready;       // the atlas and the opengl objects exist. stays 0 while mv_ef_init_async() is loading, and for good if no font could be loaded
 
     char filename[256];
 
+    // the .ttf file, mapped read-only into memory. 
+    // stays mapped, together with the parsed font info, for rasterizing glyphs later on
+    const unsigned char *ttf_data;
+    size_t ttf_size;
+    int face_index; // which face of a .ttc collection, 0 for a plain .ttf
+    stbtt_fontinfo info;
+
     // character info
-    // filled up by stb_truetype.h
-    stbtt_packedchar cdata[96]; 
+    // the first NUM_GLYPHS filled up by stb_truetype.h, the rest by mv_ef_glyph_slot()
+    stbtt_packedchar cdata[MV_EF_MAX_GLYPHS]; 
+    int glyph_layer[MV_EF_MAX_GLYPHS]; // atlas page of each glyph
+    int num_glyphs;
+
+    // codepoint -> glyph slot for the glyphs added on demand, open addressing. 
+    // keys are codepoint+1 so that 0 is empty, and codepoints no font has map to the slot of '?'
+    int glyph_table_keys[2*MV_EF_MAX_GLYPHS];
+    int glyph_table_slots[2*MV_EF_MAX_GLYPHS];
+    int glyph_table_count;
+
+    // where the next on-demand glyph goes: a shelf in the last page added for them
+    int shelf_layer; // -1 before the first one
+    int shelf_x, shelf_y, shelf_height;
+
+    // codepoints the font lacks come from the first fallback that has them
+    mv_ef_coverage *coverage; // of this font, built on first use
+    mv_ef_fallback_font fallbacks[MV_EF_MAX_FALLBACKS];
+    int num_fallbacks;
 
     // font info and data
     int height;      // bitmap height
     int width;       // bitmap width
+    int num_pages;   // number of bitmap pages, i.e. layers in the atlas texture
     float font_size; // font size in pixels
 
+    // cpu side copy of the atlas, num_pages pages of width*height each.
+    // kept around so that pages can be added later on
+    unsigned char *bitmap;
+    int page_height; // bitmap height before the unused part was cut away
+
+    // set when bitmap points into a mapped atlas cache file instead of being malloc'ed
+    const unsigned char *bitmap_mapping;
+    size_t bitmap_mapping_size;
+
     // displacement info
     float ascent;   // max distance above baseline for all glyphs
     float descent;  // max distance below baseline for all glyphs
@@ -38,13 +128,14 @@ typedef struct {
     GLuint vao; 
     GLuint program;
     
-    // font bitmap texture
+    // font bitmap texture, a GL_TEXTURE_2D_ARRAY with one layer per page
     // generated using stb_truetype.h
     GLuint texture_fontdata; 
 
     // metadata texture. 
     // first row contains information on which parts of the bitmap correspond to a glyph. 
     // the second row contain information about the relative displacement of the glyph relative to the cursor position
+    // the third row contains the atlas layer of the glyph
     GLuint texture_metadata; 
 
     // color texture
@@ -54,15 +145,238 @@ typedef struct {
     // vbos
     GLuint vbo_quad;      // vec2: simply just a regular [0,1]x[0,1] quad
     GLuint vbo_instances; // vec4: (char_pos_x, char_pos_y, char_index, color_index)
+
+    // atlas compression stats, only filled in with MV_EF_COMPRESS_ATLAS
+    float atlas_encode_ms; // time spent compressing the atlas on the cpu
+    float atlas_max_error; // largest absolute difference to the raw atlas, in [0, 255]
+    float atlas_psnr;      // peak signal-to-noise ratio against the raw atlas, in dB
+
+    // bytes of temporaries the last initialization needed. anything above MV_EF_ARENA_SIZE came from MV_EF_MALLOC
+    size_t init_arena_used;
+
+    // where the last initialization spent its time, in milliseconds. see bench_startup.c
+    float init_open_ms;    // mapping the font file and parsing its tables
+    float init_cache_ms;   // looking up the atlas cache, and writing it after a bake
+    float init_raster_ms;  // packing and rasterizing the atlas, 0 when it came from the cache
+    float init_metrics_ms; // glyph and line metrics and trimming the atlas, 0 when they came from the cache
+    float init_shader_ms;  // time the calling thread spent on the shader program. the driver compiles it while the atlas is baked
+    float init_upload_ms;  // creating the opengl objects and uploading the atlas, cpu side only
+    int init_cache_hit;    // whether the atlas came from the cache
 } mv_ef_font;
 
-void mv_ef_init(char *filename, int font_size, char *vs_filename, char *fs_filename);
+// RGTC1 (BC4) block compression of a single channel 8-bit image. width and height must be multiples of 4
+// used for the atlas texture when MV_EF_COMPRESS_ATLAS is defined
+void mv_ef_compress_rgtc1(const unsigned char *src, int width, int height, unsigned char *dst);
+void mv_ef_decompress_rgtc1(const unsigned char *src, int width, int height, unsigned char *dst);
+
+// wall clock time in milliseconds, used for the timing stats
+double mv_ef_time_ms();
+
+// maps a whole file read-only into memory. returns NULL if the file can't be opened or is empty
+const unsigned char *mv_ef_map_file(const char *filename, size_t *size);
+void mv_ef_unmap_file(const unsigned char *data, size_t size);
+
+//
+// An atlas baked offline by bake.c, which writes it out as a C header
+//
+typedef struct {
+    float font_size;
+    int width, height, num_pages; // atlas page size, and number of pages
+    float ascent, descent, linegap;
+
+    const stbtt_packedchar *cdata; // NUM_GLYPHS entries
+    const int *glyph_layer;        // NUM_GLYPHS entries
+    const unsigned char *atlas;    // run-length encoded pages, see mv_ef_rle_decompress()
+    int atlas_size;
+
+    // the atlas settings it was baked with, which have to match the program's. 
+    // height_alignment is the one of mv_ef_atlas_height_alignment(), which MV_EF_COMPRESS_ATLAS changes
+    int mip_levels, oversample_x, oversample_y, height_alignment;
+} mv_ef_baked_font;
+
+void mv_ef_rle_decompress(const unsigned char *src, int src_size, unsigned char *dst, int dst_size);
+
+int mv_ef_init(char *filename, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_init_face(char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_init_baked(const mv_ef_baked_font *baked, char *vs_filename, char *fs_filename);
+void mv_ef_init_async(char *filename, int font_size, char *vs_filename, char *fs_filename);
+void mv_ef_init_async_face(char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_num_faces(const char *filename);
+int mv_ef_find_font(const char *query, char *path, int path_size, int *face_index);
+int mv_ef_add_fallback_font(const char *filename, int face_index);
+int mv_ef_glyph_slot(int codepoint);
+int mv_ef_font_ready();
 void mv_ef_draw(char *str, char *col, float offset[2], float size);
 void mv_ef_string_dimensions(char *str, float *width, float *height, int font_size);
 void mv_ef_set_colors(unsigned char *colors);
+int mv_ef_add_atlas_page();
+void mv_ef_update_atlas_rect(int layer, int x, int y, int width, int height);
 unsigned char *mv_ef_get_colors(int *num_colors);
 mv_ef_font *mv_ef_get_font();
 
+//
+// Glyph instances, the per glyph input of the shaders, for drawing without going through strings.
+// mv_ef_map_instances() returns the instance buffer itself, mapped for writing, and mv_ef_unmap_and_draw() 
+// draws the glyphs written to it. x and y are in pixels, relative to the offset of the draw with y pointing up,
+// and the first line of text has its top at y = 0. slot comes from mv_ef_glyph_slot(), and advancing by a glyph
+// is cdata[slot].xadvance*size/font_size of mv_ef_get_font(). color is an index into the palette
+//
+typedef struct {
+    float x, y;
+    float slot;
+    float color;
+} mv_ef_instance;
+
+mv_ef_instance *mv_ef_map_instances(int count);
+void mv_ef_unmap_and_draw(float offset[2], float size);
+
+//
+// Labels, many short strings each with its own position, size and colors, drawn together by 
+// mv_ef_draw_labels() in one draw call, instead of one mv_ef_draw() each
+//
+typedef struct {
+    const char *text;
+    const char *col; // color index of every byte of text, or NULL to draw all of it in color
+    int color;
+    float x, y;      // like the offset of mv_ef_draw(), y pointing up
+    float size;
+} mv_ef_label;
+
+void mv_ef_draw_labels(const mv_ef_label *labels, int num_labels);
+
+//
+// World space labels, for text in 3d scenes. the view projection matrix is set once per frame with 
+// mv_ef_set_view_projection(), and every label is placed by its own model matrix, with the text in the 
+// xy plane of it, or as a billboard at the origin of it, facing the screen at a constant size in pixels. 
+// mv_ef_draw_world_labels() projects all of them on the gpu in one draw call, optionally depth tested
+// against the scene. matrices are column major, like glUniformMatrix4fv() without transposing
+//
+typedef struct {
+    const char *text;
+    const char *col;     // color index of every byte of text, or NULL to draw all of it in color
+    int color;
+    float offset[2];     // of the upper left corner of the text from the origin of the plane, y pointing up
+    float size;          // in pixels for billboards, otherwise in units of the plane
+    float transform[16]; // model matrix
+    int billboard;       // only the origin of transform is used
+} mv_ef_world_label;
+
+void mv_ef_set_view_projection(const float view_projection[16]);
+void mv_ef_draw_world_labels(const mv_ef_world_label *labels, int num_labels, int depth_test);
+
+//
+// Contexts. each one is a separate font renderer with its own font, atlas, textures, shader program and buffers, 
+// so several fonts or sizes can be used at once, and from several threads or opengl contexts.
+// the functions above work on a default context, and have a mv_ef_ctx_ version for any other.
+// mv_ef_destroy_context() deletes the opengl objects, so the opengl context it was used with must be current.
+// initializing a context again first releases its previous font, atlas and opengl objects, the same way
+//
+typedef struct mv_ef_context mv_ef_context;
+
+mv_ef_context *mv_ef_create_context();
+void mv_ef_destroy_context(mv_ef_context *ctx);
+mv_ef_context *mv_ef_default_context();
+
+int mv_ef_ctx_init(mv_ef_context *ctx, char *filename, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_ctx_init_face(mv_ef_context *ctx, char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_ctx_init_baked(mv_ef_context *ctx, const mv_ef_baked_font *baked, char *vs_filename, char *fs_filename);
+void mv_ef_ctx_init_async(mv_ef_context *ctx, char *filename, int font_size, char *vs_filename, char *fs_filename);
+void mv_ef_ctx_init_async_face(mv_ef_context *ctx, char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename);
+int mv_ef_ctx_add_fallback_font(mv_ef_context *ctx, const char *filename, int face_index);
+int mv_ef_ctx_glyph_slot(mv_ef_context *ctx, int codepoint);
+int mv_ef_ctx_font_ready(mv_ef_context *ctx);
+void mv_ef_ctx_draw(mv_ef_context *ctx, char *str, char *col, float offset[2], float size);
+void mv_ef_ctx_string_dimensions(mv_ef_context *ctx, char *str, float *width, float *height, int font_size);
+void mv_ef_ctx_set_colors(mv_ef_context *ctx, unsigned char *colors);
+int mv_ef_ctx_add_atlas_page(mv_ef_context *ctx);
+void mv_ef_ctx_update_atlas_rect(mv_ef_context *ctx, int layer, int x, int y, int width, int height);
+unsigned char *mv_ef_ctx_get_colors(mv_ef_context *ctx, int *num_colors);
+mv_ef_font *mv_ef_ctx_get_font(mv_ef_context *ctx);
+mv_ef_instance *mv_ef_ctx_map_instances(mv_ef_context *ctx, int count);
+void mv_ef_ctx_unmap_and_draw(mv_ef_context *ctx, float offset[2], float size);
+void mv_ef_ctx_draw_labels(mv_ef_context *ctx, const mv_ef_label *labels, int num_labels);
+void mv_ef_ctx_set_view_projection(mv_ef_context *ctx, const float view_projection[16]);
+void mv_ef_ctx_draw_world_labels(mv_ef_context *ctx, const mv_ef_world_label *labels, int num_labels, int depth_test);
+
+//
+// Frame command queue. threads that aren't allowed to touch opengl record text into their own producer
+// buffer of a queue, without locks, and the render thread draws everything recorded for a frame with 
+// mv_ef_queue_submit(), which also starts the next frame. so the producers lay out frame N+1 while frame N 
+// is drawn. mv_ef_queue_text() copies the string and colors, mv_ef_queue_text_ref() only keeps the pointers,
+// which then have to stay valid until the mv_ef_queue_submit() that draws them has returned
+//
+typedef struct mv_ef_queue mv_ef_queue;
+typedef struct mv_ef_producer mv_ef_producer;
+
+mv_ef_queue *mv_ef_create_queue(mv_ef_context *ctx);
+void mv_ef_destroy_queue(mv_ef_queue *queue);
+mv_ef_producer *mv_ef_queue_producer(mv_ef_queue *queue);
+void mv_ef_queue_text(mv_ef_producer *producer, const char *str, const char *col, float offset[2], float size);
+void mv_ef_queue_text_ref(mv_ef_producer *producer, const char *str, const char *col, float offset[2], float size);
+int mv_ef_queue_submit(mv_ef_queue *queue);
+
+//
+// Log consoles. any number of threads append lines with mv_ef_log() into a bounded ring, wait-free: 
+// a full ring drops the line instead of waiting, and mv_ef_log() returns 0. the render thread takes the new 
+// lines with mv_ef_console_update(), lays them out once into a scrollback of glyph instances on the gpu, 
+// and mv_ef_console_draw() draws the last num_rows lines of it, scroll lines up from the bottom
+//
+typedef struct mv_ef_console mv_ef_console;
+
+// the bytes of a line from start up to the next span are drawn in color
+typedef struct {
+    int start;
+    int color;
+} mv_ef_color_span;
+
+mv_ef_console *mv_ef_create_console(mv_ef_context *ctx, float font_size, int max_lines, int ring_size);
+void mv_ef_destroy_console(mv_ef_console *console);
+int mv_ef_log(mv_ef_console *console, const char *line, int color);
+int mv_ef_log_spans(mv_ef_console *console, const char *line, const mv_ef_color_span *spans, int num_spans);
+int mv_ef_console_update(mv_ef_console *console);
+void mv_ef_console_draw(mv_ef_console *console, float offset[2], int num_rows, int scroll);
+long mv_ef_console_dropped(mv_ef_console *console);
+
+//
+// Software rendering, for machines without a gpu. mv_ef_init_headless() loads a font without any opengl, 
+// and mv_ef_draw_cpu() draws a string into a framebuffer in memory, the same glyph instances mv_ef_draw() 
+// would draw, sampled and blended the way the shaders do. within a couple of levels of 8 bit rounding
+// of the gpu, and the same for any number of threads, but the sse2 and scalar blends, or a compiler that
+// fuses multiply-adds, can round a level apart. mv_ef_render_instances() draws instances laid out elsewhere
+//
+typedef struct {
+    unsigned char *pixels;
+    int width, height;
+    int stride;   // bytes from one row to the next
+    int channels; // 4 for RGBA, 1 for A8, i.e. coverage only
+} mv_ef_framebuffer;
+
+int mv_ef_init_headless(char *filename, int font_size);
+void mv_ef_draw_cpu(mv_ef_framebuffer *fb, char *str, char *col, float offset[2], float size);
+int mv_ef_ctx_init_headless(mv_ef_context *ctx, char *filename, int face_index, int font_size);
+void mv_ef_ctx_draw_cpu(mv_ef_context *ctx, mv_ef_framebuffer *fb, char *str, char *col, float offset[2], float size);
+void mv_ef_ctx_render_instances(mv_ef_context *ctx, mv_ef_framebuffer *fb, const float *instances, int count, float offset[2], float size, int num_threads);
+
+//
+// Batch rendering of text to images on the cpu, e.g. for thumbnails on a server. a pool of threads renders
+// the jobs, each into its own scratch framebuffer, all from the one atlas of a (headless) context, 
+// and done() gets every finished image, on the thread that rendered it
+//
+typedef struct {
+    const char *text;
+    const char *col;              // color index of every byte of text, or NULL for color 0
+    float size;
+    const unsigned char *palette; // rgb of all 256 color indices, or NULL for the context's colors
+    unsigned char background[4];  // rgba the image is cleared to
+    float offset[2];              // of the text from the upper left corner, like mv_ef_draw() y points up, so a margin m is {m, -m}
+    int width, height;
+} mv_ef_image_job;
+
+typedef void (*mv_ef_image_done)(int job, const mv_ef_framebuffer *fb, void *userdata);
+
+int mv_ef_render_images(const mv_ef_image_job *jobs, int num_jobs, int num_threads, mv_ef_image_done done, void *userdata);
+int mv_ef_ctx_render_images(mv_ef_context *ctx, const mv_ef_image_job *jobs, int num_jobs, int num_threads, mv_ef_image_done done, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif
@@ -72,6 +386,76 @@ mv_ef_font *mv_ef_get_font();
 
 #if defined(MV_EASY_FONT_IMPLEMENTATION) && defined(STB_TRUETYPE_IMPLEMENTATION)
 
+// glyph rasterization is spread over this many threads at most. 
+// #define MV_EF_NO_THREADS to rasterize everything on the calling thread
+#ifndef MV_EF_MAX_THREADS
+#define MV_EF_MAX_THREADS 8
+#endif
+
+#ifndef MV_EF_NO_THREADS
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
+// number of mip levels in the atlas texture. the padding between glyphs is 2^(levels-1) texels, 
+// so that glyphs don't bleed into each other in the smallest level. 
+// the default of 1 is the plain linearly filtered atlas with 1 texel padding
+#ifndef MV_EF_MIP_LEVELS
+#define MV_EF_MIP_LEVELS 1
+#endif
+
+// oversampling of the glyphs in the atlas, see stbtt_PackSetOversampling()
+#ifndef MV_EF_OVERSAMPLE_X
+#define MV_EF_OVERSAMPLE_X 1
+#endif
+#ifndef MV_EF_OVERSAMPLE_Y
+#define MV_EF_OVERSAMPLE_Y 1
+#endif
+
+// the pages of the atlas are trimmed to the glyphs baked at startup, which can leave only a few rows. 
+// before the first glyph is added on demand, all pages grow to at least this height, so that large 
+// glyphs (cjk, emoji, fallback fonts) still fit on a page
+#ifndef MV_EF_MIN_PAGE_HEIGHT
+#define MV_EF_MIN_PAGE_HEIGHT 512
+#endif
+
+// #define MV_EF_DUMP_ATLAS to write the pages of every baked atlas to font.png, for debugging.
+// stbi_write_png() has to be implemented somewhere in the program (STB_IMAGE_WRITE_IMPLEMENTATION)
+#ifdef MV_EF_DUMP_ATLAS
+#ifndef INCLUDE_STB_IMAGE_WRITE_H
+#include "stb_image_write.h"
+#endif
+#endif
+
+#ifdef MV_EF_COMPRESS_ATLAS
+#define MV_EF_ATLAS_FORMAT GL_COMPRESSED_RED_RGTC1
+#define MV_EF_ATLAS_BITS 4 // per texel
+#else
+#define MV_EF_ATLAS_FORMAT GL_R8
+#define MV_EF_ATLAS_BITS 8
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MV_EF_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+#include <stddef.h>
+#include <limits.h>
 
 #define mv_ef_num_colors 256
 
@@ -89,415 +473,4989 @@ unsigned char mv_ef_colors[mv_ef_num_colors*3] = {
 };
 
 
-// private global variable that all the functions use.
-mv_ef_font font = {0};
+//
+// Wall clock time in milliseconds, for the timing stats
+//
+double mv_ef_time_ms()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return 1000.0*t.QuadPart/freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return 1000.0*t.tv_sec + t.tv_nsec/1e6;
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return 1000.0*t.tv_sec + t.tv_nsec/1e6;
+#else
+    // strict c99 without posix. cpu time, close enough for the single threaded parts it times
+    return 1000.0*clock()/CLOCKS_PER_SEC;
+#endif
+}
 
 //
-// Return the whole font struct, in case the user want access to individual data in it
+// RGTC1 (BC4) encoder
 //
-mv_ef_font *mv_ef_get_font()
+// Every 4x4 block stores two endpoints and a 3 bit index per texel. Uses the 8 value mode with 
+// red0 = max and red1 = min of the block, which keeps the fully covered (255) and empty (0) texels 
+// that make up most of a glyph atlas exact. Indices are found by rounding the position of each 
+// texel between min and max to the nearest of the 8 palette entries, 16 texels at a time with SSE2
+//
+static void mv_ef_encode_rgtc1_block(const unsigned char texels[16], unsigned char *dst)
 {
-    return &font;
+    // palette position (0 = min, 7 = max) to bc4 index
+    static const unsigned char position_to_index[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+    unsigned char positions[16];
+    int lo, hi;
+
+#ifdef MV_EF_SSE2
+    __m128i v = _mm_loadu_si128((const __m128i*)texels);
+
+    // horizontal min and max
+    __m128i mn = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    __m128i mx = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+    lo = _mm_cvtsi128_si32(mn) & 0xFF;
+    hi = _mm_cvtsi128_si32(mx) & 0xFF;
+
+    if (hi == lo) {
+        dst[0] = hi; dst[1] = lo;
+        for (int i = 2; i < 8; i++) dst[i] = 0;
+        return;
+    }
+
+    // position = round((v - lo)*7/(hi - lo)), in float to avoid an integer division per texel
+    __m128i zero = _mm_setzero_si128();
+    __m128i d = _mm_subs_epu8(v, _mm_set1_epi8((char)lo));
+    __m128i d_lo = _mm_unpacklo_epi8(d, zero);
+    __m128i d_hi = _mm_unpackhi_epi8(d, zero);
+    __m128 scale = _mm_set1_ps(7.0f/(hi - lo));
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128i p0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d_lo, zero)), scale), half));
+    __m128i p1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d_lo, zero)), scale), half));
+    __m128i p2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d_hi, zero)), scale), half));
+    __m128i p3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d_hi, zero)), scale), half));
+    _mm_storeu_si128((__m128i*)positions, _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+#else
+    lo = 255; hi = 0;
+    for (int i = 0; i < 16; i++) {
+        if (texels[i] < lo) lo = texels[i];
+        if (texels[i] > hi) hi = texels[i];
+    }
+
+    if (hi == lo) {
+        dst[0] = hi; dst[1] = lo;
+        for (int i = 2; i < 8; i++) dst[i] = 0;
+        return;
+    }
+
+    float scale = 7.0f/(hi - lo);
+    for (int i = 0; i < 16; i++)
+        positions[i] = (unsigned char)((texels[i] - lo)*scale + 0.5f);
+#endif
+
+    dst[0] = hi;
+    dst[1] = lo;
+
+    // 16 3-bit indices, packed little endian into the remaining 48 bits
+    unsigned long long bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (unsigned long long)position_to_index[positions[i]] << (3*i);
+
+    for (int i = 0; i < 6; i++)
+        dst[2+i] = (bits >> (8*i)) & 0xFF;
 }
 
-unsigned char *mv_ef_get_colors(int *num_colors)
+void mv_ef_compress_rgtc1(const unsigned char *src, int width, int height, unsigned char *dst)
 {
-    *num_colors = mv_ef_num_colors;
-    return mv_ef_colors;
+    unsigned char texels[16];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            for (int j = 0; j < 4; j++)
+                memcpy(texels + 4*j, src + (by+j)*width + bx, 4);
+
+            mv_ef_encode_rgtc1_block(texels, dst);
+            dst += 8;
+        }
+    }
 }
 
-void mv_ef_set_colors(unsigned char *colors)
+void mv_ef_decompress_rgtc1(const unsigned char *src, int width, int height, unsigned char *dst)
 {
-    for (int i = 0; i < mv_ef_num_colors*3; i++)
-        mv_ef_colors[i] = colors[i];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            int r0 = src[0], r1 = src[1];
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_1D, font.texture_colors);
-    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, mv_ef_num_colors, GL_RGB, GL_UNSIGNED_BYTE, mv_ef_colors);
+            int palette[8] = {r0, r1};
+            if (r0 > r1) {
+                for (int i = 2; i < 8; i++)
+                    palette[i] = ((8-i)*r0 + (i-1)*r1)/7;
+            } else {
+                for (int i = 2; i < 6; i++)
+                    palette[i] = ((6-i)*r0 + (i-1)*r1)/5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+
+            unsigned long long bits = 0;
+            for (int i = 0; i < 6; i++)
+                bits |= (unsigned long long)src[2+i] << (8*i);
+
+            for (int i = 0; i < 16; i++)
+                dst[(by + i/4)*width + bx + i%4] = palette[(bits >> (3*i)) & 7];
+
+            src += 8;
+        }
+    }
 }
 
 //
-// Calculates the size of a string, in the pixel size specified. 
-// Note: Stray newlines are also counted
+// Read-only memory mapping of a whole file
 //
-void mv_ef_string_dimensions(char *str, float *width, float *height, int font_size)
+// The pages are shared through the page cache by every process that maps the same font, 
+// and nothing is copied until stb_truetype actually touches it
+//
+const unsigned char *mv_ef_map_file(const char *filename, size_t *size)
 {
-    float X = 0;
-    float Y = 0;
+    if (!filename)
+        return NULL;
 
-    int W = 0;
-    char *ptr = str;
-    while (*ptr) {
-        if (*ptr == '\n') {
-            if (X > W)
-                W = X;
-            X = 0;
-            Y++;
-        } else {
-           X += (font.cdata[*ptr-32].xadvance)*font_size/font.font_size;
-        }
-        ptr++;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
     }
 
-    // if it ended on a line with no newline
-    if (X != 0) {
-        Y++;
-        if (W == 0)
-            W = X;
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return NULL;
 
-        if (X > W)
-            W = X;
-    } 
+    // the view keeps the mapping alive
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return NULL;
 
-    *width = W;
-    *height = Y*(font.linedist)*font_size/font.font_size;
+    *size = (size_t)file_size.QuadPart;
+    return (const unsigned char*)data;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // the mapping stays valid after the file is closed
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return (const unsigned char*)data;
+#endif
 }
 
-// 
-// Reads and compiles the shaders 
-// 
-// Calls stb_truetype.h routines to read and parse a .ttf file, 
-// creates a bitmap that is uploaded to the gpu using opengl
+void mv_ef_unmap_file(const unsigned char *data, size_t size)
+{
+    if (!data)
+        return;
+
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// big-endian reads, the byte order of every TrueType table
+static unsigned int mv_ef_read_u16(const unsigned char *p) { return p[0] << 8 | p[1]; }
+static unsigned int mv_ef_read_u32(const unsigned char *p) { return (unsigned int)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
 //
-// calculates and saves a bunch of useful variables and put them in the global font variable
-// 
-void mv_ef_init(char *filename, int font_size, char *vs_filename, char *fs_filename)
+// Checks that the table directory of the font at offset lies within the file, 
+// since stb_truetype trusts the offsets it reads and does no bounds checking
+//
+static int mv_ef_validate_font(const unsigned char *data, size_t size, int offset)
+{
+    if (offset < 0 || (size_t)offset + 12 > size)
+        return 0;
+
+    const unsigned char *dir = data + offset;
+    int num_tables = dir[4] << 8 | dir[5];
+    if ((size_t)offset + 12 + 16*num_tables > size)
+        return 0;
+
+    for (int i = 0; i < num_tables; i++) {
+        const unsigned char *record = dir + 12 + 16*i;
+        size_t table_offset = (size_t)record[8]  << 24 | record[9]  << 16 | record[10] << 8 | record[11];
+        size_t table_length = (size_t)record[12] << 24 | record[13] << 16 | record[14] << 8 | record[15];
+        if (table_offset > size || table_length > size - table_offset)
+            return 0;
+    }
+
+    return 1;
+}
+
+//
+// Threading primitives used to rasterize glyphs in parallel
+//
+#ifndef MV_EF_NO_THREADS
+#if defined(_WIN32)
+typedef HANDLE mv_ef_thread;
+#define MV_EF_THREAD_PROC(name) DWORD WINAPI name(LPVOID arg)
+
+static int mv_ef_thread_create(mv_ef_thread *t, LPTHREAD_START_ROUTINE proc, void *arg)
+{
+    *t = CreateThread(NULL, 0, proc, arg, 0, NULL);
+    return *t != NULL;
+}
+
+static void mv_ef_thread_join(mv_ef_thread t)
+{
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+static int mv_ef_num_cpus()
+{
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+}
+#else
+typedef pthread_t mv_ef_thread;
+#define MV_EF_THREAD_PROC(name) void *name(void *arg)
+
+static int mv_ef_thread_create(mv_ef_thread *t, void *(*proc)(void*), void *arg)
+{
+    return pthread_create(t, NULL, proc, arg) == 0;
+}
+
+static void mv_ef_thread_join(mv_ef_thread t)
+{
+    pthread_join(t, NULL);
+}
+
+static int mv_ef_num_cpus()
+{
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+#endif
+#endif // MV_EF_NO_THREADS
+
+// flags shared between threads, stored with release and loaded with acquire semantics
+#if defined(_WIN32)
+static long mv_ef_atomic_load(volatile long *p)
+{
+    return InterlockedCompareExchange(p, 0, 0);
+}
+
+static void mv_ef_atomic_store(volatile long *p, long value)
+{
+    InterlockedExchange(p, value);
+}
+
+static long mv_ef_atomic_exchange(volatile long *p, long value)
+{
+    return InterlockedExchange(p, value);
+}
+
+static long mv_ef_atomic_add(volatile long *p, long value)
+{
+    return InterlockedExchangeAdd(p, value);
+}
+#else
+static long mv_ef_atomic_load(volatile long *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void mv_ef_atomic_store(volatile long *p, long value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+static long mv_ef_atomic_exchange(volatile long *p, long value)
+{
+    return __atomic_exchange_n(p, value, __ATOMIC_ACQ_REL);
+}
+
+// returns the previous value
+static long mv_ef_atomic_add(volatile long *p, long value)
+{
+    return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+#endif
+
+// for short critical sections only
+static void mv_ef_spin_lock(volatile long *lock)
+{
+    while (mv_ef_atomic_exchange(lock, 1))
+        while (mv_ef_atomic_load(lock)) {}
+}
+
+static void mv_ef_spin_unlock(volatile long *lock)
+{
+    mv_ef_atomic_store(lock, 0);
+}
+
+//
+// Bump arena for the temporaries of initialization: stb_truetype's per-glyph buffers, the pack context, 
+// mip levels, compression buffers and the like. one MV_EF_ARENA_SIZE block is allocated when
+// initialization starts and freed in one go when it's done, instead of thousands of small malloc/free pairs.
+// allocation is a single atomic add, so the rasterization threads share it. 
+// anything that doesn't fit falls back to MV_EF_MALLOC, and font.init_arena_used tells how much was needed
+//
+#ifndef MV_EF_ARENA_SIZE
+#define MV_EF_ARENA_SIZE (4 << 20)
+#endif
+
+typedef struct {
+    unsigned char *base;
+    long size;
+    volatile long used;
+} mv_ef_arena;
+
+static void *mv_ef_arena_alloc(mv_ef_arena *arena, size_t size)
+{
+    if (arena && arena->base && size <= (size_t)arena->size) {
+        long aligned = (long)(size + 15) & ~15L;
+        long offset = mv_ef_atomic_add(&arena->used, aligned);
+        if (offset + aligned <= arena->size)
+            return arena->base + offset;
+    }
+    return MV_EF_MALLOC(size);
+}
+
+static void mv_ef_arena_free(mv_ef_arena *arena, void *ptr)
+{
+    unsigned char *p = (unsigned char*)ptr;
+    if (arena && arena->base && p >= arena->base && p < arena->base + arena->size)
+        return; // released with the whole arena
+    MV_EF_FREE(ptr);
+}
+
+static void mv_ef_arena_begin(mv_ef_arena *arena)
+{
+    if (!arena->base) {
+        arena->base = (unsigned char*)MV_EF_MALLOC(MV_EF_ARENA_SIZE);
+        arena->size = arena->base ? MV_EF_ARENA_SIZE : 0;
+    }
+    mv_ef_atomic_store(&arena->used, 0);
+}
+
+static size_t mv_ef_arena_end(mv_ef_arena *arena)
+{
+    size_t used = (size_t)mv_ef_atomic_load(&arena->used);
+    MV_EF_FREE(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    return used;
+}
+
+// the userdata of stb_truetype's allocations is the arena to use, or NULL for the heap
+void *mv_ef_stbtt_malloc(size_t size, void *userdata)
+{
+    return userdata ? mv_ef_arena_alloc((mv_ef_arena*)userdata, size) : MV_EF_MALLOC(size);
+}
+
+void mv_ef_stbtt_free(void *ptr, void *userdata)
+{
+    if (ptr)
+        mv_ef_arena_free((mv_ef_arena*)userdata, ptr);
+}
+
+//
+// Contexts
+//
+// A context is one independent font renderer: the font struct with its atlas, metadata and color textures, 
+// shader program and buffers, and the machinery around it. nothing in here is shared between contexts, so 
+// several fonts or sizes can be used side by side, and contexts can be used from different threads and 
+// opengl contexts, each context by one thread at a time. the font files and the disk caches are shared.
+// the functions without a context work on a default one
+//
+#ifndef MV_EF_PBO_RING_SIZE
+#define MV_EF_PBO_RING_SIZE 4
+#endif
+
+typedef struct {
+    GLuint buffer;
+    GLsync fence;
+    int capacity;
+} mv_ef_pbo;
+
+typedef struct {
+    mv_ef_pbo pbos[MV_EF_PBO_RING_SIZE];
+    int next;
+    int mapped; // the next pbo is bound and mapped
+} mv_ef_pbo_ring;
+
+// a shader program the driver may still be compiling, see mv_ef_begin_program()
+typedef struct {
+    GLuint program;
+    GLuint vs, fs;               // 0 when the program came from the binary cache
+    unsigned long long key;      // binary cache key, 0 if binary caching isn't available
+    int parallel;                // KHR_parallel_shader_compile
+} mv_ef_program_build;
+
+// the state of mv_ef_init_async() between the worker thread and mv_ef_font_ready()
+typedef struct {
+    int pending;
+    int threaded;
+    volatile long cpu_done;
+#ifndef MV_EF_NO_THREADS
+    mv_ef_thread thread;
+#endif
+    mv_ef_program_build build;
+    char filename[256];
+    int has_filename;
+    int face_index;
+    int font_size;
+    int loaded; // result of mv_ef_load_font(), valid once cpu_done is set
+} mv_ef_async_state;
+
+// uniform buffer binding of the view projection matrix of mv_ef_draw_world_labels()
+#ifndef MV_EF_WORLD_BINDING
+#define MV_EF_WORLD_BINDING 0
+#endif
+
+struct mv_ef_context {
+    mv_ef_font font;
+    int created;                              // the palette is filled in
+    unsigned char colors[mv_ef_num_colors*3]; // contents of the color texture
+    float *glyph_data;                        // instance data of mv_ef_draw(), 4 floats per glyph
+    mv_ef_arena arena;                        // temporaries of initialization
+    mv_ef_pbo_ring pbo_ring;                  // atlas uploads
+    mv_ef_async_state async;
+    int headless;                             // no opengl objects, see mv_ef_init_headless()
+    int mapped_instances;                     // count of mv_ef_map_instances(), 0 when not mapped
+    float *label_instances;                   // instances of mv_ef_draw_labels()
+    float *label_scales;                      // their instanceScale
+    float *label_indices;                     // their instanceLabel, for world space labels
+    int label_capacity;
+    GLuint vbo_label_scales, vbo_label_indices;
+    mv_ef_label *world_labels;                // mv_ef_draw_world_labels() in the planes of the labels
+    float *world_table;                       // model matrix and billboard flag of every world label
+    int world_capacity;
+    GLuint tbo_world_table, texture_world_table, ubo_world;
+};
+
+// temporaries, from the context's init arena while initializing and from the heap otherwise
+static void *mv_ef_temp_alloc(mv_ef_context *ctx, size_t size)
+{
+    return mv_ef_arena_alloc(&ctx->arena, size);
+}
+
+static void mv_ef_temp_free(mv_ef_context *ctx, void *ptr)
+{
+    mv_ef_arena_free(&ctx->arena, ptr);
+}
+
+// the context of the functions without one
+static mv_ef_context mv_ef_default;
+
+// a zeroed context gets its palette on first use
+static mv_ef_context *mv_ef_prepare_context(mv_ef_context *ctx)
+{
+    if (!ctx->created) {
+        memcpy(ctx->colors, mv_ef_colors, sizeof(ctx->colors));
+        ctx->created = 1;
+    }
+    return ctx;
+}
+
+mv_ef_context *mv_ef_default_context()
+{
+    return mv_ef_prepare_context(&mv_ef_default);
+}
+
+mv_ef_context *mv_ef_create_context()
+{
+    mv_ef_context *ctx = (mv_ef_context*)MV_EF_MALLOC(sizeof(mv_ef_context));
+    memset(ctx, 0, sizeof(*ctx));
+    return mv_ef_prepare_context(ctx);
+}
+
+//
+// Return the whole font struct, in case the user want access to individual data in it
+//
+mv_ef_font *mv_ef_ctx_get_font(mv_ef_context *ctx)
+{
+    return &ctx->font;
+}
+
+unsigned char *mv_ef_ctx_get_colors(mv_ef_context *ctx, int *num_colors)
+{
+    *num_colors = mv_ef_num_colors;
+    return ctx->colors;
+}
+
+void mv_ef_ctx_set_colors(mv_ef_context *ctx, unsigned char *colors)
+{
+    if (colors != ctx->colors) // e.g. edited in place through mv_ef_get_colors()
+        memcpy(ctx->colors, colors, sizeof(ctx->colors));
+    if (!ctx->font.ready || ctx->headless)
+        return; // uploaded with the rest
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_1D, ctx->font.texture_colors);
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, mv_ef_num_colors, GL_RGB, GL_UNSIGNED_BYTE, ctx->colors);
+}
+
+//
+// Calculates the size of a string, in the pixel size specified. 
+// Note: Stray newlines are also counted
+//
+static int mv_ef_decode_utf8(const char **str);
+
+void mv_ef_ctx_string_dimensions(mv_ef_context *ctx, char *str, float *width, float *height, int font_size)
+{
+    mv_ef_font *font = &ctx->font;
+    if (!mv_ef_ctx_font_ready(ctx)) {
+        *width = *height = 0.0;
+        return;
+    }
+
+    float X = 0;
+    float Y = 0;
+
+    int W = 0;
+    char *ptr = str;
+    while (*ptr) {
+        if (*ptr == '\n') {
+            if (X > W)
+                W = X;
+            X = 0;
+            Y++;
+            ptr++;
+        } else {
+            const char *c = ptr;
+            int codepoint = mv_ef_decode_utf8(&c);
+            X += (font->cdata[mv_ef_ctx_glyph_slot(ctx, codepoint)].xadvance)*font_size/font->font_size;
+            ptr = (char*)c;
+        }
+    }
+
+    // if it ended on a line with no newline
+    if (X != 0) {
+        Y++;
+        if (W == 0)
+            W = X;
+
+        if (X > W)
+            W = X;
+    } 
+
+    *width = W;
+    *height = Y*(font->linedist)*font_size/font->font_size;
+}
+
+//
+// Font files mapped once per process and shared by every face opened from them, reference counted.
+// a .ttc collection of regular, bold and mono faces is mapped once, instead of once per face. 
+// files are identified by their absolute path
+//
+#ifndef MV_EF_MAX_FONT_FILES
+#define MV_EF_MAX_FONT_FILES 16
+#endif
+
+typedef struct {
+    char path[1024];
+    const unsigned char *data;
+    size_t size;
+    int refcount;
+} mv_ef_font_file;
+
+static mv_ef_font_file mv_ef_font_files[MV_EF_MAX_FONT_FILES];
+static volatile long mv_ef_font_files_lock;
+
+static const unsigned char *mv_ef_acquire_font_file(const char *filename, size_t *size)
+{
+    if (!filename)
+        return NULL;
+
+#if defined(_WIN32)
+    char path[_MAX_PATH];
+    if (!_fullpath(path, filename, sizeof(path)))
+        return NULL;
+#elif defined(PATH_MAX)
+    char path[PATH_MAX];
+    if (!realpath(filename, path))
+        return NULL;
+#else
+    // no realpath() in strict c99, files are only shared when they're opened by the same path
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s", filename) >= (int)sizeof(path))
+        return NULL;
+#endif
+    int shareable = strlen(path) < sizeof(mv_ef_font_files[0].path);
+
+    mv_ef_spin_lock(&mv_ef_font_files_lock);
+
+    const unsigned char *data = NULL;
+    mv_ef_font_file *free_slot = NULL;
+    for (int i = 0; i < MV_EF_MAX_FONT_FILES; i++) {
+        mv_ef_font_file *f = &mv_ef_font_files[i];
+        if (f->refcount > 0 && shareable && strcmp(f->path, path) == 0) {
+            f->refcount++;
+            data = f->data;
+            *size = f->size;
+            break;
+        }
+        if (f->refcount == 0 && !free_slot)
+            free_slot = f;
+    }
+
+    if (!data) {
+        size_t mapped_size = 0;
+        data = mv_ef_map_file(path, &mapped_size);
+        if (data && free_slot && shareable) {
+            strcpy(free_slot->path, path);
+            free_slot->data = data;
+            free_slot->size = mapped_size;
+            free_slot->refcount = 1;
+        } else if (data && shareable) {
+            // registry full, a private mapping still works
+            printf("Warning: more than %d font files open, \"%s\" is not shared\n", MV_EF_MAX_FONT_FILES, path);
+        }
+        *size = mapped_size;
+    }
+
+    mv_ef_spin_unlock(&mv_ef_font_files_lock);
+    return data;
+}
+
+static void mv_ef_release_font_file(const unsigned char *data, size_t size)
+{
+    if (!data)
+        return;
+
+    mv_ef_spin_lock(&mv_ef_font_files_lock);
+
+    int shared = 0;
+    for (int i = 0; i < MV_EF_MAX_FONT_FILES; i++) {
+        mv_ef_font_file *f = &mv_ef_font_files[i];
+        if (f->refcount > 0 && f->data == data) {
+            shared = 1;
+            if (--f->refcount == 0) {
+                mv_ef_unmap_file(f->data, f->size);
+                f->data = NULL;
+            }
+            break;
+        }
+    }
+    if (!shared)
+        mv_ef_unmap_file(data, size);
+
+    mv_ef_spin_unlock(&mv_ef_font_files_lock);
+}
+
+//
+// Number of faces in a font file: 1 for a .ttf, and any number for a .ttc collection. 0 if it can't be read
+//
+int mv_ef_num_faces(const char *filename)
+{
+    size_t size;
+    const unsigned char *data = mv_ef_acquire_font_file(filename, &size);
+    if (!data)
+        return 0;
+
+    int num_faces = size >= 16 ? stbtt_GetNumberOfFonts(data) : 0;
+    mv_ef_release_font_file(data, size);
+    return num_faces < 0 ? 0 : num_faces;
+}
+
+// one disjoint subset of the glyphs, rasterized by a single thread
+typedef struct {
+    stbtt_pack_context pc; // private copy, since stbtt temporarily writes the oversampling into it
+    const stbtt_fontinfo *info;
+    stbtt_pack_range range;
+    stbrp_rect *rects;
+} mv_ef_raster_job;
+
+#ifndef MV_EF_NO_THREADS
+static MV_EF_THREAD_PROC(mv_ef_raster_thread)
+{
+    mv_ef_raster_job *job = (mv_ef_raster_job*)arg;
+    stbtt_PackFontRangesRenderIntoRects(&job->pc, job->info, &job->range, 1, job->rects);
+    return 0;
+}
+#endif
+
+//
+// Rasterizes all the jobs at once, one thread each. 
+// the calling thread takes the first job itself, and if a thread can't be created 
+// its job is rasterized serially as well
+//
+static void mv_ef_run_raster_jobs(mv_ef_raster_job *jobs, int num_jobs)
+{
+#ifndef MV_EF_NO_THREADS
+    mv_ef_thread threads[MV_EF_MAX_THREADS];
+    int started[MV_EF_MAX_THREADS] = {0};
+    for (int i = 1; i < num_jobs; i++)
+        started[i] = mv_ef_thread_create(&threads[i], mv_ef_raster_thread, &jobs[i]);
+
+    for (int i = 0; i < num_jobs; i++) 
+        if (!started[i]) 
+            stbtt_PackFontRangesRenderIntoRects(&jobs[i].pc, jobs[i].info, &jobs[i].range, 1, jobs[i].rects);
+
+    for (int i = 1; i < num_jobs; i++)
+        if (started[i]) 
+            mv_ef_thread_join(threads[i]);
+#else
+    for (int i = 0; i < num_jobs; i++) 
+        stbtt_PackFontRangesRenderIntoRects(&jobs[i].pc, jobs[i].info, &jobs[i].range, 1, jobs[i].rects);
+#endif
+}
+
+//
+// Packs the glyphs into atlas pages and fills in font.cdata and font.glyph_layer
+//
+// Does the same as stbtt_PackFontRange(), but split into its three phases so that 
+// the rasterization, which dominates for large font sizes, can run on several threads. 
+// Gathering and packing the rects is cheap and done serially. Glyphs that don't fit 
+// on a page spill over onto the next one. Then for each page, every thread renders 
+// a contiguous subset of the page's glyphs into its own (non-overlapping) rects
+//
+// Returns the bitmap of all the pages, each font.width x font.height, one after the other
+//
+static unsigned char *mv_ef_pack_glyphs(mv_ef_context *ctx, const stbtt_fontinfo *info, int *num_pages)
+{
+    mv_ef_font *font = &ctx->font;
+    int page_size = font->width*font->height;
+    int padding = 1 << (MV_EF_MIP_LEVELS-1);
+
+    stbtt_pack_context pc;
+    stbtt_PackBegin(&pc, NULL, font->width, font->height, 0, padding, info->userdata);
+    stbtt_PackSetOversampling(&pc, MV_EF_OVERSAMPLE_X, MV_EF_OVERSAMPLE_Y);
+
+    stbtt_pack_range range = {0};
+    range.font_size = font->font_size;
+    range.first_unicode_codepoint_in_range = 32;
+    range.num_chars = NUM_GLYPHS;
+    range.chardata_for_range = font->cdata;
+
+    stbrp_rect rects[NUM_GLYPHS];
+    int n = stbtt_PackFontRangesGatherRects(&pc, info, &range, 1, rects);
+    stbtt_PackEnd(&pc);
+
+    for (int i = 0; i < n; i++) {
+        rects[i].id = i;
+        memset(&font->cdata[i], 0, sizeof(font->cdata[i]));
+        font->glyph_layer[i] = 0;
+    }
+
+    // sorted by page, i.e. the order in which they are packed
+    stbrp_rect sorted_rects[NUM_GLYPHS];
+    memcpy(sorted_rects, rects, n*sizeof(stbrp_rect));
+    int codepoints[NUM_GLYPHS];
+    stbtt_packedchar cdata[NUM_GLYPHS];
+
+    int num_threads = 1;
+#ifndef MV_EF_NO_THREADS
+    num_threads = mv_ef_num_cpus();
+    if (num_threads > MV_EF_MAX_THREADS) num_threads = MV_EF_MAX_THREADS;
+    if (num_threads < 1) num_threads = 1;
+#endif
+
+    unsigned char *bitmap = NULL;
+    int pages = 0;
+    int remaining = n;
+    while (remaining > 0) {
+        bitmap = (unsigned char*)MV_EF_REALLOC(bitmap, (pages+1)*page_size);
+        unsigned char *page = bitmap + pages*page_size;
+
+        stbtt_PackBegin(&pc, page, font->width, font->height, 0, padding, info->userdata);
+        stbtt_PackSetOversampling(&pc, MV_EF_OVERSAMPLE_X, MV_EF_OVERSAMPLE_Y);
+
+        // pack as many of the remaining rects as possible, 
+        // and move the ones that made it onto this page to the front
+        stbrp_rect *page_rects = sorted_rects + (n - remaining);
+        stbtt_PackFontRangesPackRects(&pc, page_rects, remaining);
+
+        int packed = 0;
+        for (int i = 0; i < remaining; i++)
+            if (page_rects[i].was_packed)
+                rects[packed++] = page_rects[i];
+        for (int i = 0, j = packed; i < remaining; i++)
+            if (!page_rects[i].was_packed)
+                rects[j++] = page_rects[i];
+        memcpy(page_rects, rects, remaining*sizeof(stbrp_rect));
+
+        if (packed == 0) {
+            // a glyph larger than a page. leave it and the rest empty
+            printf("Error: glyph too large for a %dx%d atlas page\n", font->width, font->height);
+            stbtt_PackEnd(&pc);
+            break;
+        }
+
+        for (int i = 0; i < packed; i++) {
+            codepoints[n - remaining + i] = 32 + page_rects[i].id;
+            font->glyph_layer[page_rects[i].id] = pages;
+        }
+
+        // split the page's glyphs into disjoint subsets
+        int num_jobs = packed < num_threads ? packed : num_threads;
+        mv_ef_raster_job jobs[MV_EF_MAX_THREADS];
+        for (int i = 0; i < num_jobs; i++) {
+            int start = (n - remaining) + i*packed/num_jobs;
+            int stop  = (n - remaining) + (i+1)*packed/num_jobs;
+
+            jobs[i].pc = pc;
+            jobs[i].info = info;
+            jobs[i].range = range;
+            jobs[i].range.first_unicode_codepoint_in_range = 0;
+            jobs[i].range.array_of_unicode_codepoints = codepoints + start;
+            jobs[i].range.num_chars = stop - start;
+            jobs[i].range.chardata_for_range = cdata + start;
+            jobs[i].rects = sorted_rects + start;
+        }
+        mv_ef_run_raster_jobs(jobs, num_jobs);
+
+        stbtt_PackEnd(&pc);
+
+        for (int i = 0; i < packed; i++)
+            font->cdata[page_rects[i].id] = cdata[n - remaining + i];
+
+        remaining -= packed;
+        pages++;
+    }
+
+    *num_pages = pages;
+    return bitmap;
+}
+
+//
+// Halves the size of a single channel image by averaging 2x2 texels. 
+// the average keeps the total glyph coverage, so small text keeps its weight instead of thinning out
+//
+static void mv_ef_downsample_coverage(const unsigned char *src, int width, int height, unsigned char *dst)
+{
+    for (int y = 0; y < height/2; y++) {
+        const unsigned char *row0 = src + (2*y+0)*width;
+        const unsigned char *row1 = src + (2*y+1)*width;
+        for (int x = 0; x < width/2; x++)
+            dst[y*(width/2) + x] = (row0[2*x] + row0[2*x+1] + row1[2*x] + row1[2*x+1] + 2)/4;
+    }
+}
+
+//
+// Atlas uploads stream through a small ring of pixel unpack buffers, so that glTex(Sub)Image never
+// has to copy client memory or wait for the gpu before returning. the texels are written into the
+// mapped buffer, the upload is issued from it and a fence marks when the gpu is done with it.
+// a buffer whose fence hasn't signaled yet when its turn comes around again gets fresh storage
+// instead (the driver keeps the old one alive), so the cpu never waits either.
+// #define MV_EF_NO_PBO to upload straight from client memory
+//
+//
+// Returns size bytes to write the texels of one upload into, 
+// either mapped pbo memory or, if that fails, a temporary buffer
+//
+static unsigned char *mv_ef_begin_atlas_upload(mv_ef_context *ctx, int size)
+{
+#ifndef MV_EF_NO_PBO
+    mv_ef_pbo *pbo = &ctx->pbo_ring.pbos[ctx->pbo_ring.next];
+    if (!pbo->buffer)
+        glGenBuffers(1, &pbo->buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->buffer);
+
+    int in_flight = 0;
+    if (pbo->fence) {
+        GLenum status = glClientWaitSync(pbo->fence, 0, 0);
+        in_flight = status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED;
+        glDeleteSync(pbo->fence);
+        pbo->fence = 0;
+    }
+
+    if (size > pbo->capacity || in_flight) {
+        if (size > pbo->capacity)
+            pbo->capacity = size;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo->capacity, NULL, GL_STREAM_DRAW);
+    }
+
+    // unsynchronized is safe, since the gpu is done with this storage
+    void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped) {
+        ctx->pbo_ring.mapped = 1;
+        return (unsigned char*)mapped;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
+    return (unsigned char*)mv_ef_temp_alloc(ctx, size);
+}
+
+//
+// Uploads the texels from mv_ef_begin_atlas_upload() into a rectangle of one layer of the bound atlas texture.
+// they are raw, or rgtc1 blocks with MV_EF_COMPRESS_ATLAS
+//
+static void mv_ef_end_atlas_upload(mv_ef_context *ctx, unsigned char *data, int size, int level, int x, int y, int layer, int width, int height)
+{
+    const void *pixels = data;
+    int mapped = ctx->pbo_ring.mapped;
+    if (mapped) {
+        // if the contents got lost (e.g. a display mode change), the uploaded texels are undefined.
+        // there is no copy to retry with, the next upload of this part of the atlas fixes it
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        pixels = (const void*)0; // offset into the pbo
+    }
+
+#ifdef MV_EF_COMPRESS_ATLAS
+    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x, y, layer, width, height, 1, GL_COMPRESSED_RED_RGTC1, size, pixels);
+#else
+    (void)size;
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x, y, layer, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, pixels);
+#endif
+
+    if (mapped) {
+        mv_ef_pbo *pbo = &ctx->pbo_ring.pbos[ctx->pbo_ring.next];
+        pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        ctx->pbo_ring.next = (ctx->pbo_ring.next + 1) % MV_EF_PBO_RING_SIZE;
+        ctx->pbo_ring.mapped = 0;
+    } else {
+        mv_ef_temp_free(ctx, data);
+    }
+}
+
+//
+// Uploads one mip level of a range of layers of the bound atlas texture, either raw or rgtc1 compressed. 
+// the layers are stored one after the other in pixels
+//
+static void mv_ef_upload_atlas_level(mv_ef_context *ctx, int level, int width, int height, int first_layer, int num_layers, const unsigned char *pixels)
+{
+#ifdef MV_EF_COMPRESS_ATLAS
+    mv_ef_font *font = &ctx->font;
+
+    // compress to rgtc1 on the cpu, half the memory of GL_R8. 
+    // since the layer height is a multiple of 4, the layers can be compressed as one tall image
+    // keeps track of the encoding time and the error compared to the raw atlas for the base level
+    int compressed_size = width*height*num_layers/2;
+    unsigned char *compressed = (unsigned char*)mv_ef_temp_alloc(ctx, compressed_size);
+
+    double t0 = mv_ef_time_ms();
+    mv_ef_compress_rgtc1(pixels, width, height*num_layers, compressed);
+
+    if (level == 0) {
+        font->atlas_encode_ms = mv_ef_time_ms() - t0;
+
+        unsigned char *decoded = (unsigned char*)mv_ef_temp_alloc(ctx, width*height*num_layers);
+        mv_ef_decompress_rgtc1(compressed, width, height*num_layers, decoded);
+
+        double sum_squared = 0.0;
+        font->atlas_max_error = 0.0;
+        for (int i = 0; i < width*height*num_layers; i++) {
+            int diff = abs(decoded[i] - pixels[i]);
+            sum_squared += diff*diff;
+            if (diff > font->atlas_max_error)
+                font->atlas_max_error = diff;
+        }
+        double mse = sum_squared/(width*height*num_layers);
+        font->atlas_psnr = mse > 0.0 ? 10.0*log10(255.0*255.0/mse) : INFINITY;
+        mv_ef_temp_free(ctx, decoded);
+    }
+
+    pixels = compressed;
+#endif
+
+    // one layer at a time, so that a pbo never needs to hold more than a page
+    int layer_size = (int)(MV_EF_ATLAS_BITS*width*height/8);
+    for (int i = 0; i < num_layers; i++) {
+        unsigned char *data = mv_ef_begin_atlas_upload(ctx, layer_size);
+        memcpy(data, pixels + i*layer_size, layer_size);
+        mv_ef_end_atlas_upload(ctx, data, layer_size, level, 0, 0, first_layer + i, width, height);
+    }
+
+#ifdef MV_EF_COMPRESS_ATLAS
+    mv_ef_temp_free(ctx, compressed);
+#endif
+}
+
+//
+// Uploads a range of pages of font.bitmap to the bound atlas texture, 
+// all mip levels included, each one downsampled from the previous
+//
+static void mv_ef_upload_atlas_layers(mv_ef_context *ctx, int first_layer, int num_layers)
+{
+    mv_ef_font *font = &ctx->font;
+    unsigned char *pages = font->bitmap + first_layer*font->width*font->height;
+
+    int level_width = font->width;
+    int level_height = font->height;
+    unsigned char *level_pixels = pages;
+    for (int level = 0; level < MV_EF_MIP_LEVELS; level++) {
+        if (level > 0) {
+            // the layer height is even in every level, so the layers can be downsampled as one tall image
+            unsigned char *downsampled = (unsigned char*)mv_ef_temp_alloc(ctx, (level_width/2)*(level_height/2)*num_layers);
+            mv_ef_downsample_coverage(level_pixels, level_width, level_height*num_layers, downsampled);
+            if (level_pixels != pages) 
+                mv_ef_temp_free(ctx, level_pixels);
+
+            level_pixels = downsampled;
+            level_width /= 2;
+            level_height /= 2;
+        }
+
+        mv_ef_upload_atlas_level(ctx, level, level_width, level_height, first_layer, num_layers, level_pixels);
+    }
+    if (level_pixels != pages) 
+        mv_ef_temp_free(ctx, level_pixels);
+}
+
+//
+// Re-uploads a rectangle of one page of font.bitmap, e.g. after rasterizing glyphs into it.
+// only the rectangle (grown to whole blocks of the smallest mip level) goes through the pbo ring,
+// with every mip level downsampled and, with MV_EF_COMPRESS_ATLAS, compressed straight into the mapped buffer
+//
+// note that font.bitmap is read-only while it points into the atlas cache file (font.bitmap_mapping)
+//
+void mv_ef_ctx_update_atlas_rect(mv_ef_context *ctx, int layer, int x, int y, int width, int height)
+{
+    mv_ef_font *font = &ctx->font;
+    if (ctx->headless || !mv_ef_ctx_font_ready(ctx) || layer < 0 || layer >= font->num_pages || width <= 0 || height <= 0)
+        return;
+
+    int alignment = 1 << (MV_EF_MIP_LEVELS-1);
+#ifdef MV_EF_COMPRESS_ATLAS
+    alignment *= 4;
+#endif
+    int x0 = x & ~(alignment-1);
+    int y0 = y & ~(alignment-1);
+    int x1 = (x + width + alignment-1) & ~(alignment-1);
+    int y1 = (y + height + alignment-1) & ~(alignment-1);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > font->width) x1 = font->width;
+    if (y1 > font->height) y1 = font->height;
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    int w = x1 - x0;
+    int h = y1 - y0;
+    unsigned char *level_pixels = (unsigned char*)mv_ef_temp_alloc(ctx, w*h);
+    const unsigned char *page = font->bitmap + (size_t)layer*font->width*font->height;
+    for (int row = 0; row < h; row++)
+        memcpy(level_pixels + row*w, page + (y0+row)*font->width + x0, w);
+
+    GLint last_texture;
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &last_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, font->texture_fontdata);
+
+    for (int level = 0; level < MV_EF_MIP_LEVELS; level++) {
+        if (level > 0) {
+            mv_ef_downsample_coverage(level_pixels, w, h, level_pixels); // in place, each row is read before it's written
+            w /= 2;
+            h /= 2;
+        }
+
+        int size = (int)(MV_EF_ATLAS_BITS*w*h/8);
+        unsigned char *data = mv_ef_begin_atlas_upload(ctx, size);
+#ifdef MV_EF_COMPRESS_ATLAS
+        mv_ef_compress_rgtc1(level_pixels, w, h, data);
+#else
+        memcpy(data, level_pixels, size);
+#endif
+        mv_ef_end_atlas_upload(ctx, data, size, level, x0 >> level, y0 >> level, layer, w, h);
+    }
+
+    mv_ef_temp_free(ctx, level_pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, last_texture);
+}
+
+//
+// Creates an empty atlas texture with room for num_layers pages, and leaves it bound to GL_TEXTURE0
+//
+static GLuint mv_ef_create_atlas_texture(mv_ef_context *ctx, int num_layers)
+{
+    mv_ef_font *font = &ctx->font;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+    for (int level = 0; level < MV_EF_MIP_LEVELS; level++) {
+        int w = font->width >> level;
+        int h = font->height >> level;
+#ifdef MV_EF_COMPRESS_ATLAS
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, MV_EF_ATLAS_FORMAT, w, h, num_layers, 0, w*h*num_layers/2, NULL);
+#else
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, MV_EF_ATLAS_FORMAT, w, h, num_layers, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+#endif
+    }
+
+    // trilinear filtering kicks in whenever the text is drawn smaller than the baked size, i.e. scale_factor < 1
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, MV_EF_MIP_LEVELS-1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, MV_EF_MIP_LEVELS > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return texture;
+}
+
+static int mv_ef_has_extension(const char *extension)
+{
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (int i = 0; i < num_extensions; i++)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), extension) == 0)
+            return 1;
+
+    return 0;
+}
+
+//
+// Checks whether the current context is at least the given opengl version, or has the given extension
+//
+static int mv_ef_has_gl(int major, int minor, const char *extension)
+{
+    GLint context_major = 0, context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    if (context_major > major || (context_major == major && context_minor >= minor))
+        return 1;
+
+    return extension && mv_ef_has_extension(extension);
+}
+
+//
+// Adds an empty page to the atlas, and returns its layer index
+//
+// The array texture can't grow in place, so a new one is created with one more layer. 
+// the existing layers are copied over on the gpu with glCopyImageSubData where available (GL 4.3), 
+// and re-uploaded from the cpu side copy of the atlas otherwise
+//
+int mv_ef_ctx_add_atlas_page(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    if (!mv_ef_ctx_font_ready(ctx))
+        return -1;
+
+    if (!font->ttf_data && font->num_fallbacks == 0) {
+        printf("Error: no font file to rasterize an atlas page from (baked font?)\n");
+        return -1;
+    }
+
+    int layer = font->num_pages;
+    int page_size = font->width*font->height;
+
+    if (font->bitmap_mapping) {
+        // the cached atlas is read-only, so it needs a private copy from now on
+        unsigned char *bitmap = (unsigned char*)MV_EF_MALLOC((layer+1)*page_size);
+        memcpy(bitmap, font->bitmap, layer*page_size);
+        mv_ef_unmap_file(font->bitmap_mapping, font->bitmap_mapping_size);
+        font->bitmap = bitmap;
+        font->bitmap_mapping = NULL;
+    } else {
+        font->bitmap = (unsigned char*)MV_EF_REALLOC(font->bitmap, (layer+1)*page_size);
+    }
+    memset(font->bitmap + layer*page_size, 0, page_size);
+
+    if (ctx->headless) {
+        font->num_pages++;
+        return layer;
+    }
+
+    GLint last_texture;
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &last_texture);
+
+    GLuint old_texture = font->texture_fontdata;
+    font->texture_fontdata = mv_ef_create_atlas_texture(ctx, layer+1);
+
+    if (mv_ef_has_gl(4, 3, "GL_ARB_copy_image")) {
+        for (int level = 0; level < MV_EF_MIP_LEVELS; level++) {
+            glCopyImageSubData(old_texture,           GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, 
+                               font->texture_fontdata, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, 
+                               font->width >> level, font->height >> level, layer);
+        }
+        mv_ef_upload_atlas_layers(ctx, layer, 1);
+    } else {
+        mv_ef_upload_atlas_layers(ctx, 0, layer+1);
+    }
+
+    glDeleteTextures(1, &old_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, last_texture == (GLint)old_texture ? font->texture_fontdata : (GLuint)last_texture);
+
+    font->num_pages++;
+    return layer;
+}
+
+// the atlas height is cut to a multiple of this, which keeps it divisible all the way down to the smallest 
+// mip level, and in whole 4x4 blocks in every level with MV_EF_COMPRESS_ATLAS
+static int mv_ef_atlas_height_alignment(void)
+{
+    int alignment = 1 << (MV_EF_MIP_LEVELS-1);
+#ifdef MV_EF_COMPRESS_ATLAS
+    alignment *= 4;
+#endif
+    return alignment;
+}
+
+//
+// Rasterizes the atlas pages and computes the glyph and line metrics, from font.info
+//
+static void mv_ef_bake_atlas(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    // Pack and create bitmap pages
+    // stb_truetype's temporaries come from the init arena
+    double t0 = mv_ef_time_ms();
+    font->info.userdata = &ctx->arena;
+    font->bitmap = mv_ef_pack_glyphs(ctx, &font->info, &font->num_pages);
+    font->info.userdata = NULL;
+    font->bitmap_mapping = NULL;
+    double t1 = mv_ef_time_ms();
+    font->init_raster_ms = t1 - t0;
+
+#ifdef MV_EF_DUMP_ATLAS
+    stbi_write_png("font.png", font->width, font->height*font->num_pages, 1, font->bitmap, 0);
+#endif
+
+    // calculate vertical font metrics
+    float s = stbtt_ScaleForPixelHeight(&font->info, font->font_size);
+    int a, d, l;
+    stbtt_GetFontVMetrics(&font->info, &a, &d, &l);
+    
+    font->ascent = a*s;
+    font->descent = d*s;
+    font->linegap = l*s;
+    font->linedist = font->ascent - font->descent + font->linegap;
+
+    // output char metrics per char
+    int max_y1 = 0; // for truncating packed texture if nescessary
+    for (int i = 0; i < 96; i++) {
+        /*
+        printf("%3d %2c: (%3u, %3u, %3u, %3u), %+6.2f, %+6.2f, %+6.2f, %+6.2f, %f\n", i, i+32, 
+                                                                                      font->cdata[i].x0,    font->cdata[i].y0, 
+                                                                                      font->cdata[i].x1,    font->cdata[i].y1,
+                                                                                      font->cdata[i].xoff,  font->cdata[i].yoff, 
+                                                                                      font->cdata[i].xoff2, font->cdata[i].yoff2,
+                                                                                      font->cdata[i].xadvance);
+        */
+        if (font->cdata[i].y1 > max_y1)
+            max_y1 = font->cdata[i].y1;
+    }
+
+    // cut away the unused part of the bitmap
+    int alignment = mv_ef_atlas_height_alignment();
+    font->height = (max_y1+1 + alignment-1) & ~(alignment-1);
+
+    // move the pages together
+    for (int i = 1; i < font->num_pages; i++)
+        memmove(font->bitmap + i*font->width*font->height, font->bitmap + i*font->width*font->page_height, font->width*font->height);
+
+    font->init_metrics_ms = mv_ef_time_ms() - t1;
+}
+
+//
+// On-disk cache of the baked atlas
+//
+// Rasterizing the atlas is by far the most expensive part of mv_ef_init(), and the result only depends on 
+// the font file and the atlas parameters. So the atlas pages, the glyph metrics and the line metrics are 
+// written to a binary file named by a hash of those, and on the next start the file is mapped and uploaded 
+// directly, without rasterizing anything. 
+// 
+// The cache lives in MV_EF_CACHE_DIR if defined, otherwise in $XDG_CACHE_HOME/mv_easy_font, 
+// ~/.cache/mv_easy_font or %LOCALAPPDATA%/mv_easy_font. #define MV_EF_NO_CACHE to disable it. 
+// Bump MV_EF_CACHE_VERSION whenever the file layout or the baking changes
+//
+#define MV_EF_CACHE_VERSION 3
+
+typedef struct {
+    char magic[8]; // "mv_ef_at"
+    unsigned int version;
+    unsigned int header_size;
+    unsigned long long key;
+
+    // what the atlas was baked with, checked on load in addition to the key
+    unsigned long long font_hash;
+    unsigned long long font_file_size;
+    int face_index;
+    float font_size;
+    int oversample_x, oversample_y;
+    int padding;
+    int height_alignment; // see mv_ef_atlas_height_alignment(), differs with MV_EF_COMPRESS_ATLAS
+    int first_codepoint, num_glyphs;
+
+    // the atlas itself
+    int width, height, num_pages;
+    float ascent, descent, linegap;
+
+    // followed by: stbtt_packedchar cdata[num_glyphs], int glyph_layer[num_glyphs], 
+    //              unsigned char bitmap[num_pages*height*width]
+} mv_ef_atlas_cache_header;
+
+//
+// Fast 64-bit hash, 8 bytes per step. Only used for cache keys, so it doesn't need to be very strong
+//
+static unsigned long long mv_ef_hash(const void *data, size_t size, unsigned long long h)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    h ^= size*0x9E3779B97F4A7C15ULL;
+
+    while (size >= 8) {
+        unsigned long long word;
+        memcpy(&word, p, 8);
+        h = (h ^ word)*0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+        p += 8;
+        size -= 8;
+    }
+
+    while (size--) {
+        h = (h ^ *p++)*0x94D049BB133111EBULL;
+        h ^= h >> 29;
+    }
+
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+//
+// Full path of a file in the cache directory, creating the directory if needed. returns 0 if there is no cache
+//
+static int mv_ef_cache_path(char *path, int path_size, const char *name)
+{
+#ifdef MV_EF_NO_CACHE
+    (void)path; (void)path_size; (void)name;
+    return 0;
+#else
+    char dir[512];
+#if defined(MV_EF_CACHE_DIR)
+    snprintf(dir, sizeof(dir), "%s", MV_EF_CACHE_DIR);
+#elif defined(_WIN32)
+    const char *base = getenv("LOCALAPPDATA");
+    if (!base) return 0;
+    snprintf(dir, sizeof(dir), "%s/mv_easy_font", base);
+    CreateDirectoryA(dir, NULL);
+#else
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && xdg[0]) {
+        snprintf(dir, sizeof(dir), "%s/mv_easy_font", xdg);
+    } else if (home && home[0]) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+        mkdir(dir, 0755);
+        snprintf(dir, sizeof(dir), "%s/.cache/mv_easy_font", home);
+    } else {
+        return 0;
+    }
+    mkdir(dir, 0755);
+#endif
+    return snprintf(path, path_size, "%s/%s", dir, name) < path_size;
+#endif
+}
+
+//
+// Writes a file in one go, through a temporary file and a rename, 
+// so that other processes never see a partially written file
+//
+static int mv_ef_write_file_atomic(const char *path, const void *data1, size_t size1, const void *data2, size_t size2)
+{
+    char tmp_path[600];
+#if defined(_WIN32)
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+#else
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+#endif
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp)
+        return 0;
+
+    int ok = fwrite(data1, 1, size1, fp) == size1;
+    if (size2) 
+        ok = ok && fwrite(data2, 1, size2, fp) == size2;
+    ok = (fclose(fp) == 0) && ok;
+
+#if defined(_WIN32)
+    ok = ok && MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmp_path, path) == 0;
+#endif
+    if (!ok)
+        remove(tmp_path);
+    return ok;
+}
+
+// the parameters the atlas is baked with, which together with the font make up the cache key
+static mv_ef_atlas_cache_header mv_ef_atlas_cache_key(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_atlas_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "mv_ef_at", 8);
+    header.version = MV_EF_CACHE_VERSION;
+    header.header_size = sizeof(header);
+    header.font_hash = mv_ef_hash(font->ttf_data, font->ttf_size, 0);
+    header.font_file_size = font->ttf_size;
+    header.face_index = font->face_index;
+    header.font_size = font->font_size;
+    header.oversample_x = MV_EF_OVERSAMPLE_X;
+    header.oversample_y = MV_EF_OVERSAMPLE_Y;
+    header.padding = 1 << (MV_EF_MIP_LEVELS-1);
+    header.height_alignment = mv_ef_atlas_height_alignment();
+    header.first_codepoint = 32;
+    header.num_glyphs = NUM_GLYPHS;
+    header.width = font->width;   // page size before cutting
+    header.height = font->page_height;
+
+    header.key = mv_ef_hash(&header, sizeof(header), 0);
+    return header;
+}
+
+static void mv_ef_atlas_cache_filename(char *name, int name_size, unsigned long long key)
+{
+    snprintf(name, name_size, "mv_ef_atlas_%016llx.bin", key);
+}
+
+//
+// Fills in the atlas and the metrics from the cache, if there is a matching entry. 
+// font.bitmap then points straight into the mapped file
+//
+static int mv_ef_load_atlas_cache(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_atlas_cache_header key = mv_ef_atlas_cache_key(ctx);
+
+    char name[64], path[600];
+    mv_ef_atlas_cache_filename(name, sizeof(name), key.key);
+    if (!mv_ef_cache_path(path, sizeof(path), name))
+        return 0;
+
+    size_t size;
+    const unsigned char *data = mv_ef_map_file(path, &size);
+    if (!data)
+        return 0;
+
+    mv_ef_atlas_cache_header header;
+    if (size < sizeof(header)) {
+        mv_ef_unmap_file(data, size);
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    // everything up to the atlas dimensions has to match exactly
+    size_t metrics_size = header.num_glyphs*(sizeof(stbtt_packedchar) + sizeof(int));
+    size_t bitmap_size = (size_t)header.num_pages*header.width*header.height;
+    if (memcmp(&header, &key, offsetof(mv_ef_atlas_cache_header, width)) != 0 ||
+        header.width != key.width || header.height <= 0 || header.height > key.height || header.height % key.height_alignment != 0 || header.num_pages <= 0 ||
+        size != sizeof(header) + metrics_size + bitmap_size) {
+        mv_ef_unmap_file(data, size);
+        return 0;
+    }
+
+    const unsigned char *ptr = data + sizeof(header);
+    memcpy(font->cdata, ptr, NUM_GLYPHS*sizeof(stbtt_packedchar));
+    ptr += NUM_GLYPHS*sizeof(stbtt_packedchar);
+    memcpy(font->glyph_layer, ptr, NUM_GLYPHS*sizeof(int));
+    ptr += NUM_GLYPHS*sizeof(int);
+
+    font->width = header.width;
+    font->height = header.height;
+    font->num_pages = header.num_pages;
+    font->ascent = header.ascent;
+    font->descent = header.descent;
+    font->linegap = header.linegap;
+    font->linedist = font->ascent - font->descent + font->linegap;
+
+    font->bitmap = (unsigned char*)ptr;
+    font->bitmap_mapping = data;
+    font->bitmap_mapping_size = size;
+    return 1;
+}
+
+//
+// Stores the freshly baked atlas in the cache
+//
+static void mv_ef_save_atlas_cache(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_atlas_cache_header header = mv_ef_atlas_cache_key(ctx);
+
+    char name[64], path[600];
+    mv_ef_atlas_cache_filename(name, sizeof(name), header.key);
+    if (!mv_ef_cache_path(path, sizeof(path), name))
+        return;
+
+    header.width = font->width;
+    header.height = font->height;
+    header.num_pages = font->num_pages;
+    header.ascent = font->ascent;
+    header.descent = font->descent;
+    header.linegap = font->linegap;
+
+    size_t metrics_size = NUM_GLYPHS*(sizeof(stbtt_packedchar) + sizeof(int));
+    size_t bitmap_size = (size_t)font->num_pages*font->width*font->height;
+    unsigned char *contents = (unsigned char*)mv_ef_temp_alloc(ctx, sizeof(header) + metrics_size);
+    memcpy(contents, &header, sizeof(header));
+    memcpy(contents + sizeof(header), font->cdata, NUM_GLYPHS*sizeof(stbtt_packedchar));
+    memcpy(contents + sizeof(header) + NUM_GLYPHS*sizeof(stbtt_packedchar), font->glyph_layer, NUM_GLYPHS*sizeof(int));
+
+    mv_ef_write_file_atomic(path, contents, sizeof(header) + metrics_size, font->bitmap, bitmap_size);
+    mv_ef_temp_free(ctx, contents);
+}
+
+//
+// Font discovery
+//
+// The font directories of the system (/usr/share/fonts and friends, the user's font directories, 
+// the Windows and macOS font folders) are scanned once, reading only the name, OS/2 and post tables 
+// of every face. family, style, weight, monospace/serif flags and the OS/2 unicode ranges go into a 
+// compact index file in the cache directory, so that resolving a query like "monospace, regular" 
+// later on is one mapped lookup instead of a directory walk. 
+// 
+// The index remembers every directory it walked and their modification times, and is rebuilt when 
+// any of them changed, which is one stat() per directory and no reading of directory contents. 
+// With MV_EF_NO_CACHE the index is built in memory on every lookup
+//
+#define MV_EF_FONT_INDEX_VERSION 1
+
+#define MV_EF_FACE_ITALIC 1
+#define MV_EF_FACE_MONO   2
+#define MV_EF_FACE_SERIF  4
+#define MV_EF_FACE_SANS   8
+
+typedef struct {
+    char magic[8]; // "mv_ef_fi"
+    unsigned int version;
+    unsigned int num_faces;
+    unsigned int num_dirs;
+    unsigned int strings_size;
+    unsigned long long stamp; // hash of the font directories, and the paths and modification times of every directory walked
+
+    // followed by: unsigned int dirs[num_dirs] (string offsets), mv_ef_font_index_face faces[num_faces], 
+    //              char strings[strings_size]
+} mv_ef_font_index_header;
+
+typedef struct {
+    unsigned int path, family, style; // offsets into the string table
+    unsigned short face_index;
+    unsigned short weight;            // OS/2 usWeightClass, 400 is regular and 700 bold
+    unsigned int flags;               // MV_EF_FACE_*
+    unsigned int unicode_ranges[4];   // OS/2 ulUnicodeRange1-4, one bit per group of unicode blocks
+} mv_ef_font_index_face;
+
+// the index while it's being built, with its string table
+typedef struct {
+    mv_ef_font_index_face *faces;
+    int num_faces, max_faces;
+    unsigned int *dirs;
+    int num_dirs, max_dirs;
+    char *strings;
+    unsigned int strings_size, max_strings;
+} mv_ef_font_index_builder;
+
+static unsigned int mv_ef_index_add_string(mv_ef_font_index_builder *b, const char *str)
+{
+    unsigned int len = strlen(str) + 1;
+    if (b->strings_size + len > b->max_strings) {
+        b->max_strings = 2*(b->strings_size + len);
+        b->strings = (char*)MV_EF_REALLOC(b->strings, b->max_strings);
+    }
+
+    unsigned int offset = b->strings_size;
+    memcpy(b->strings + offset, str, len);
+    b->strings_size += len;
+    return offset;
+}
+
+// modification time of a directory, 0 if it doesn't exist
+static unsigned long long mv_ef_dir_mtime(const char *path)
+{
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return 0;
+    return (unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return 0;
+
+    // with the nanoseconds where there are any, a font installed within the same second as the scan still counts
+#if defined(__APPLE__)
+    return (unsigned long long)st.st_mtime*1000000000ULL + st.st_mtimespec.tv_nsec;
+#elif defined(__linux__) && defined(st_mtime)
+    // st_mtime is a macro for st_mtim.tv_sec wherever st_mtim exists
+    return (unsigned long long)st.st_mtime*1000000000ULL + st.st_mtim.tv_nsec;
+#else
+    return (unsigned long long)st.st_mtime;
+#endif
+#endif
+}
+
+// where fonts are installed. directories that don't exist yet are included, so creating them triggers a rescan
+static int mv_ef_font_dirs(char dirs[][512], int max_dirs)
+{
+    memset(dirs, 0, max_dirs*sizeof(dirs[0])); // hashed as a whole
+    int n = 0;
+#if defined(_WIN32)
+    const char *windir = getenv("WINDIR");
+    const char *local = getenv("LOCALAPPDATA");
+    snprintf(dirs[n++], 512, "%s/Fonts", windir ? windir : "C:/Windows");
+    if (local && n < max_dirs)
+        snprintf(dirs[n++], 512, "%s/Microsoft/Windows/Fonts", local);
+#else
+    const char *system_dirs[] = {
+        "/usr/share/fonts",
+        "/usr/local/share/fonts",
+        "/System/Library/Fonts",
+        "/Library/Fonts",
+    };
+    for (int i = 0; i < 4 && n < max_dirs; i++)
+        snprintf(dirs[n++], 512, "%s", system_dirs[i]);
+
+    const char *home = getenv("HOME");
+    const char *xdg = getenv("XDG_DATA_HOME");
+    if (xdg && xdg[0] && n < max_dirs)
+        snprintf(dirs[n++], 512, "%s/fonts", xdg);
+    else if (home && home[0] && n < max_dirs)
+        snprintf(dirs[n++], 512, "%s/.local/share/fonts", home);
+    if (home && home[0] && n < max_dirs)
+        snprintf(dirs[n++], 512, "%s/.fonts", home);
+    if (home && home[0] && n < max_dirs)
+        snprintf(dirs[n++], 512, "%s/Library/Fonts", home);
+#endif
+    return n;
+}
+
+// one string of the name table, as utf-8. prefers the english windows names, then the mac roman ones
+static void mv_ef_read_font_name(const unsigned char *table, size_t length, int name_id, char *out, int out_size)
+{
+    out[0] = '\0';
+    if (length < 6)
+        return;
+
+    unsigned int count = mv_ef_read_u16(table + 2);
+    unsigned int storage = mv_ef_read_u16(table + 4);
+    if (6 + 12*(size_t)count > length)
+        return;
+
+    const unsigned char *best = NULL;
+    int best_score = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        const unsigned char *record = table + 6 + 12*i;
+        unsigned int platform = mv_ef_read_u16(record), encoding = mv_ef_read_u16(record + 2);
+        unsigned int language = mv_ef_read_u16(record + 4);
+        if (mv_ef_read_u16(record + 6) != (unsigned int)name_id)
+            continue;
+        if ((size_t)storage + mv_ef_read_u16(record + 10) + mv_ef_read_u16(record + 8) > length)
+            continue;
+
+        int score = 0;
+        if (platform == 3 && (encoding == 1 || encoding == 10))
+            score = language == 0x409 ? 4 : 3;
+        else if (platform == 0)
+            score = 2;
+        else if (platform == 1 && encoding == 0 && language == 0)
+            score = 1;
+        if (score > best_score) {
+            best_score = score;
+            best = record;
+        }
+    }
+    if (!best)
+        return;
+
+    const unsigned char *str = table + storage + mv_ef_read_u16(best + 10);
+    unsigned int len = mv_ef_read_u16(best + 8);
+    int n = 0;
+    if (mv_ef_read_u16(best) == 1) {
+        // mac roman, only the ascii part
+        for (unsigned int i = 0; i < len && n < out_size-1; i++)
+            out[n++] = str[i] < 128 ? str[i] : '?';
+    } else {
+        // utf-16 big-endian. names outside the basic multilingual plane don't happen in practice
+        for (unsigned int i = 0; i + 1 < len; i += 2) {
+            unsigned int c = mv_ef_read_u16(str + i);
+            if (c >= 0xD800 && c < 0xE000)
+                c = '?';
+            if (c < 0x80 && n < out_size-1) {
+                out[n++] = c;
+            } else if (c < 0x800 && n < out_size-2) {
+                out[n++] = 0xC0 | c >> 6;
+                out[n++] = 0x80 | (c & 63);
+            } else if (c >= 0x800 && n < out_size-3) {
+                out[n++] = 0xE0 | c >> 12;
+                out[n++] = 0x80 | ((c >> 6) & 63);
+                out[n++] = 0x80 | (c & 63);
+            } else {
+                break;
+            }
+        }
+    }
+    out[n] = '\0';
+}
+
+// offset and length of a table of the font at font_offset, 0 if there is none. the font must be validated
+static size_t mv_ef_find_font_table(const unsigned char *data, int font_offset, const char *tag, size_t *length)
+{
+    const unsigned char *dir = data + font_offset;
+    int num_tables = mv_ef_read_u16(dir + 4);
+    for (int i = 0; i < num_tables; i++) {
+        const unsigned char *record = dir + 12 + 16*i;
+        if (memcmp(record, tag, 4) == 0) {
+            *length = mv_ef_read_u32(record + 12);
+            return mv_ef_read_u32(record + 8);
+        }
+    }
+    *length = 0;
+    return 0;
+}
+
+static int mv_ef_lower(int c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+
+static int mv_ef_contains_nocase(const char *str, const char *word)
+{
+    for (; *str; str++) {
+        int i = 0;
+        while (word[i] && str[i] && mv_ef_lower(str[i]) == mv_ef_lower(word[i]))
+            i++;
+        if (!word[i])
+            return 1;
+    }
+    return 0;
+}
+
+// adds every face of a font file to the index
+static void mv_ef_index_font_file(mv_ef_font_index_builder *b, const char *path)
+{
+    size_t size;
+    const unsigned char *data = mv_ef_map_file(path, &size);
+    if (!data)
+        return;
+
+    int num_faces = size >= 16 ? stbtt_GetNumberOfFonts(data) : 0;
+    for (int i = 0; i < num_faces && i < 0x10000; i++) {
+        int offset = stbtt_GetFontOffsetForIndex(data, i);
+        if (!mv_ef_validate_font(data, size, offset))
+            continue;
+
+        // only fonts stb_truetype can rasterize, i.e. with truetype outlines
+        size_t length, glyf = mv_ef_find_font_table(data, offset, "glyf", &length);
+        size_t name_length, name = mv_ef_find_font_table(data, offset, "name", &name_length);
+        if (!glyf || !name || !mv_ef_find_font_table(data, offset, "cmap", &length))
+            continue;
+
+        // the typographic family and subfamily group all weights under one name, where present
+        char family[256], style[256];
+        mv_ef_read_font_name(data + name, name_length, 16, family, sizeof(family));
+        if (!family[0])
+            mv_ef_read_font_name(data + name, name_length, 1, family, sizeof(family));
+        mv_ef_read_font_name(data + name, name_length, 17, style, sizeof(style));
+        if (!style[0])
+            mv_ef_read_font_name(data + name, name_length, 2, style, sizeof(style));
+        if (!family[0])
+            continue;
+
+        mv_ef_font_index_face face;
+        memset(&face, 0, sizeof(face));
+        face.face_index = i;
+        face.weight = mv_ef_contains_nocase(style, "bold") ? 700 : 400;
+        if (mv_ef_contains_nocase(style, "italic") || mv_ef_contains_nocase(style, "oblique"))
+            face.flags |= MV_EF_FACE_ITALIC;
+
+        size_t os2_length, os2 = mv_ef_find_font_table(data, offset, "OS/2", &os2_length);
+        int family_kind = 0, serif_style = 0;
+        if (os2 && os2_length >= 64) {
+            const unsigned char *t = data + os2;
+            unsigned int weight = mv_ef_read_u16(t + 4);
+            if (weight >= 100 && weight <= 1000)
+                face.weight = weight;
+
+            // panose: family kind 2 is latin text, with the serif style and the proportion (9 is monospaced)
+            family_kind = t[32];
+            serif_style = t[33];
+            if (family_kind == 2 && t[35] == 9)
+                face.flags |= MV_EF_FACE_MONO;
+
+            for (int k = 0; k < 4; k++)
+                face.unicode_ranges[k] = mv_ef_read_u32(t + 42 + 4*k);
+            if (mv_ef_read_u16(t + 62) & 1)
+                face.flags |= MV_EF_FACE_ITALIC;
+        }
+
+        // post.isFixedPitch, since the panose is often left empty
+        size_t post_length, post = mv_ef_find_font_table(data, offset, "post", &post_length);
+        if (post && post_length >= 16 && mv_ef_read_u32(data + post + 12))
+            face.flags |= MV_EF_FACE_MONO;
+
+        if (family_kind == 2 && serif_style >= 2 && serif_style <= 10)
+            face.flags |= MV_EF_FACE_SERIF;
+        else if (family_kind == 2 && serif_style >= 11)
+            face.flags |= MV_EF_FACE_SANS;
+        else if (mv_ef_contains_nocase(family, "sans"))
+            face.flags |= MV_EF_FACE_SANS;
+        else if (mv_ef_contains_nocase(family, "serif"))
+            face.flags |= MV_EF_FACE_SERIF;
+
+        if (b->num_faces == b->max_faces) {
+            b->max_faces = b->max_faces ? 2*b->max_faces : 256;
+            b->faces = (mv_ef_font_index_face*)MV_EF_REALLOC(b->faces, b->max_faces*sizeof(mv_ef_font_index_face));
+        }
+        face.path = mv_ef_index_add_string(b, path);
+        face.family = mv_ef_index_add_string(b, family);
+        face.style = mv_ef_index_add_string(b, style);
+        b->faces[b->num_faces++] = face;
+    }
+
+    mv_ef_unmap_file(data, size);
+}
+
+static int mv_ef_has_font_extension(const char *name)
+{
+    size_t len = strlen(name);
+    return len > 4 && (mv_ef_contains_nocase(name + len - 4, ".ttf") || mv_ef_contains_nocase(name + len - 4, ".ttc"));
+}
+
+// walks a font directory and its subdirectories, recording every directory for the staleness check
+static void mv_ef_index_font_dir(mv_ef_font_index_builder *b, const char *dir, int depth)
+{
+    if (b->num_dirs == b->max_dirs) {
+        b->max_dirs = b->max_dirs ? 2*b->max_dirs : 64;
+        b->dirs = (unsigned int*)MV_EF_REALLOC(b->dirs, b->max_dirs*sizeof(unsigned int));
+    }
+    b->dirs[b->num_dirs++] = mv_ef_index_add_string(b, dir);
+
+    char path[1024];
+#if defined(_WIN32)
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s/*", dir);
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA(pattern, &data);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (data.cFileName[0] == '.')
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, data.cFileName) >= (int)sizeof(path))
+            continue;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (depth < 8) 
+                mv_ef_index_font_dir(b, path, depth+1);
+        } else if (mv_ef_has_font_extension(data.cFileName)) {
+            mv_ef_index_font_file(b, path);
+        }
+    } while (FindNextFileA(h, &data));
+    FindClose(h);
+#else
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        if (entry->d_name[0] == '.')
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path))
+            continue;
+
+        // the depth limit also keeps symlink loops finite
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode)) {
+            if (depth < 8)
+                mv_ef_index_font_dir(b, path, depth+1);
+        } else if (mv_ef_has_font_extension(entry->d_name)) {
+            mv_ef_index_font_file(b, path);
+        }
+    }
+    closedir(d);
+#endif
+}
+
+// the font directories of this system and user, and how every directory of the index looks now
+static unsigned long long mv_ef_font_index_stamp(const char *strings, const unsigned int *dirs, int num_dirs)
+{
+    char roots[8][512];
+    int num_roots = mv_ef_font_dirs(roots, 8);
+    unsigned long long stamp = mv_ef_hash(roots, num_roots*sizeof(roots[0]), 0);
+
+    for (int i = 0; i < num_dirs; i++) {
+        const char *dir = strings + dirs[i];
+        unsigned long long mtime = mv_ef_dir_mtime(dir);
+        stamp = mv_ef_hash(dir, strlen(dir), stamp);
+        stamp = mv_ef_hash(&mtime, sizeof(mtime), stamp);
+    }
+    return stamp;
+}
+
+// the faces in path order, so that equally good matches resolve the same way on every scan. 
+// every face carries a pointer to its path, since indexes can be built on several threads at once
+typedef struct {
+    const char *path;
+    mv_ef_font_index_face face;
+} mv_ef_index_sort_entry;
+
+static int mv_ef_compare_index_faces(const void *a, const void *b)
+{
+    const mv_ef_index_sort_entry *x = (const mv_ef_index_sort_entry*)a, *y = (const mv_ef_index_sort_entry*)b;
+    int c = strcmp(x->path, y->path);
+    return c ? c : (int)x->face.face_index - (int)y->face.face_index;
+}
+
+//
+// Scans the font directories and returns the index in its file format, allocated with MV_EF_MALLOC
+//
+static unsigned char *mv_ef_build_font_index(size_t *size)
+{
+    double t0 = mv_ef_time_ms();
+
+    mv_ef_font_index_builder b;
+    memset(&b, 0, sizeof(b));
+
+    char roots[8][512];
+    int num_roots = mv_ef_font_dirs(roots, 8);
+    for (int i = 0; i < num_roots; i++)
+        mv_ef_index_font_dir(&b, roots[i], 0);
+
+    if (b.num_faces > 1) {
+        mv_ef_index_sort_entry *entries = (mv_ef_index_sort_entry*)MV_EF_MALLOC(b.num_faces*sizeof(mv_ef_index_sort_entry));
+        for (int i = 0; i < b.num_faces; i++) {
+            entries[i].path = b.strings + b.faces[i].path;
+            entries[i].face = b.faces[i];
+        }
+        qsort(entries, b.num_faces, sizeof(mv_ef_index_sort_entry), mv_ef_compare_index_faces);
+        for (int i = 0; i < b.num_faces; i++)
+            b.faces[i] = entries[i].face;
+        MV_EF_FREE(entries);
+    }
+
+    mv_ef_font_index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "mv_ef_fi", 8);
+    header.version = MV_EF_FONT_INDEX_VERSION;
+    header.num_faces = b.num_faces;
+    header.num_dirs = b.num_dirs;
+    header.strings_size = b.strings_size;
+    header.stamp = mv_ef_font_index_stamp(b.strings, b.dirs, b.num_dirs);
+
+    size_t dirs_size = b.num_dirs*sizeof(unsigned int);
+    size_t faces_size = b.num_faces*sizeof(mv_ef_font_index_face);
+    *size = sizeof(header) + dirs_size + faces_size + b.strings_size;
+
+    unsigned char *index = (unsigned char*)MV_EF_MALLOC(*size);
+    memcpy(index, &header, sizeof(header));
+    if (dirs_size) memcpy(index + sizeof(header), b.dirs, dirs_size);
+    if (faces_size) memcpy(index + sizeof(header) + dirs_size, b.faces, faces_size);
+    if (b.strings_size) memcpy(index + sizeof(header) + dirs_size + faces_size, b.strings, b.strings_size);
+
+    MV_EF_FREE(b.faces);
+    MV_EF_FREE(b.dirs);
+    MV_EF_FREE(b.strings);
+
+    printf("Indexed %d font faces in %d directories (%.1f ms)\n", header.num_faces, header.num_dirs, mv_ef_time_ms() - t0);
+    return index;
+}
+
+// checks the layout of an index, and that every string offset is inside the string table
+static int mv_ef_font_index_valid(const unsigned char *index, size_t size)
+{
+    mv_ef_font_index_header header;
+    if (size < sizeof(header))
+        return 0;
+    memcpy(&header, index, sizeof(header));
+    if (memcmp(header.magic, "mv_ef_fi", 8) != 0 || header.version != MV_EF_FONT_INDEX_VERSION)
+        return 0;
+
+    size_t dirs_size = (size_t)header.num_dirs*sizeof(unsigned int);
+    size_t faces_size = (size_t)header.num_faces*sizeof(mv_ef_font_index_face);
+    if (size != sizeof(header) + dirs_size + faces_size + header.strings_size || header.strings_size == 0)
+        return 0;
+
+    const char *strings = (const char*)index + sizeof(header) + dirs_size + faces_size;
+    if (strings[header.strings_size-1] != '\0')
+        return 0;
+
+    const unsigned int *dirs = (const unsigned int*)(index + sizeof(header));
+    for (unsigned int i = 0; i < header.num_dirs; i++)
+        if (dirs[i] >= header.strings_size)
+            return 0;
+
+    const mv_ef_font_index_face *faces = (const mv_ef_font_index_face*)(index + sizeof(header) + dirs_size);
+    for (unsigned int i = 0; i < header.num_faces; i++)
+        if (faces[i].path >= header.strings_size || faces[i].family >= header.strings_size || faces[i].style >= header.strings_size)
+            return 0;
+
+    // the directories haven't changed since the scan
+    return header.stamp == mv_ef_font_index_stamp(strings, dirs, header.num_dirs);
+}
+
+static int mv_ef_equals_nocase(const char *a, const char *b)
+{
+    while (*a && mv_ef_lower(*a) == mv_ef_lower(*b)) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+// copies the next comma separated part of a query, without surrounding spaces
+static const char *mv_ef_query_part(const char *query, char *part, int part_size)
+{
+    while (*query == ' ')
+        query++;
+
+    int n = 0;
+    while (*query && *query != ',') {
+        if (n < part_size-1)
+            part[n++] = *query;
+        query++;
+    }
+    while (n > 0 && part[n-1] == ' ')
+        n--;
+    part[n] = '\0';
+
+    return *query == ',' ? query+1 : query;
+}
+
+//
+// The best face in an index for a query, -1 if none matches
+//
+static int mv_ef_match_font_index(const unsigned char *index, const char *query)
+{
+    mv_ef_font_index_header header;
+    memcpy(&header, index, sizeof(header));
+    const mv_ef_font_index_face *faces = (const mv_ef_font_index_face*)(index + sizeof(header) + header.num_dirs*sizeof(unsigned int));
+    const char *strings = (const char*)(faces + header.num_faces);
+
+    char family[256], style[256];
+    query = mv_ef_query_part(query, family, sizeof(family));
+    mv_ef_query_part(query, style, sizeof(style));
+
+    // generic families match by the flags, anything else by name
+    int generic = 0;
+    if (mv_ef_equals_nocase(family, "monospace") || mv_ef_equals_nocase(family, "mono"))
+        generic = MV_EF_FACE_MONO;
+    else if (mv_ef_equals_nocase(family, "sans-serif") || mv_ef_equals_nocase(family, "sans"))
+        generic = MV_EF_FACE_SANS;
+    else if (mv_ef_equals_nocase(family, "serif"))
+        generic = MV_EF_FACE_SERIF;
+
+    int weight = 400;
+    const char *weights[] = {"thin", "extralight", "light", "regular", "medium", "semibold", "bold", "extrabold", "black"};
+    for (int i = 0; i < 9; i++)
+        if (mv_ef_contains_nocase(style, weights[i]))
+            weight = 100*(i+1); // the last one found wins, so "extrabold" isn't taken for "bold"
+    if (mv_ef_contains_nocase(style, "heavy"))
+        weight = 900;
+    int italic = mv_ef_contains_nocase(style, "italic") || mv_ef_contains_nocase(style, "oblique");
+
+    // exact family names win over partial ones
+    int best = -1;
+    long best_score = LONG_MAX;
+    for (int pass = 0; pass < 2 && best < 0; pass++) {
+        for (unsigned int i = 0; i < header.num_faces; i++) {
+            const mv_ef_font_index_face *face = &faces[i];
+            if (generic) {
+                // a generic family has to be able to show basic latin
+                if (pass > 0 || !(face->flags & generic) || !(face->unicode_ranges[0] & 1))
+                    continue;
+            } else {
+                const char *name = strings + face->family;
+                if (pass == 0 ? !mv_ef_equals_nocase(name, family) : !mv_ef_contains_nocase(name, family))
+                    continue;
+            }
+
+            // the style first, then the most unicode coverage
+            long score = 1000L*abs((int)face->weight - weight) + (((face->flags & MV_EF_FACE_ITALIC) != 0) != italic)*1000000L;
+            for (int k = 0; k < 4; k++)
+                for (unsigned int r = face->unicode_ranges[k]; r; r &= r-1)
+                    score--;
+
+            if (score < best_score) {
+                best_score = score;
+                best = i;
+            }
+        }
+    }
+
+    return best;
+}
+
+//
+// Resolves a font query like "monospace, regular", "sans-serif, bold italic" or "DejaVu Sans Mono, bold" 
+// to a font file and face on this system. returns 0 if no installed font matches
+//
+int mv_ef_find_font(const char *query, char *path, int path_size, int *face_index)
+{
+    if (!query || !query[0])
+        return 0;
+
+    char index_path[600];
+    int has_path = mv_ef_cache_path(index_path, sizeof(index_path), "mv_ef_font_index.bin");
+
+    size_t size = 0;
+    const unsigned char *mapped = has_path ? mv_ef_map_file(index_path, &size) : NULL;
+    unsigned char *built = NULL;
+    if (mapped && !mv_ef_font_index_valid(mapped, size)) {
+        mv_ef_unmap_file(mapped, size);
+        mapped = NULL;
+    }
+    if (!mapped) {
+        built = mv_ef_build_font_index(&size);
+        if (has_path)
+            mv_ef_write_file_atomic(index_path, built, size, NULL, 0);
+    }
+
+    const unsigned char *index = mapped ? mapped : built;
+    int found = 0;
+    int match = mv_ef_match_font_index(index, query);
+    if (match >= 0) {
+        mv_ef_font_index_header header;
+        memcpy(&header, index, sizeof(header));
+        const mv_ef_font_index_face *faces = (const mv_ef_font_index_face*)(index + sizeof(header) + header.num_dirs*sizeof(unsigned int));
+        const char *strings = (const char*)(faces + header.num_faces);
+
+        found = snprintf(path, path_size, "%s", strings + faces[match].path) < path_size;
+        if (face_index)
+            *face_index = faces[match].face_index;
+    }
+
+    if (mapped)
+        mv_ef_unmap_file(mapped, size);
+    MV_EF_FREE(built);
+    return found;
+}
+
+// 
+// Maps and parses the .ttf file. a filename that isn't a file is taken as a font query for 
+// mv_ef_find_font(), and without either the bundled Inconsolata or any monospace font of the system is used.
+// sets up the font struct for baking an atlas at font_size. returns 0 if there is no usable font
+//
+static int mv_ef_open_font(mv_ef_context *ctx, const char *filename, int face_index, int font_size)
+{
+    mv_ef_font *font = &ctx->font;
+    // reinitializing, the previous font file may still be shared with other faces
+    mv_ef_release_font_file(font->ttf_data, font->ttf_size);
+    font->ttf_data = NULL;
+
+    // load .ttf into a bitmap using stb_truetype.h
+    font->width = 512;
+    font->height = 512;
+    font->page_height = 512;
+    font->font_size = font_size;
+
+    // Map the font file
+    const char *ttf_filenames[] = {
+        "extra/Inconsolata-Regular.ttf",
+        "Inconsolata-Regular.ttf",
+    };
+
+    // mv_ef_find_font() fails for a path that doesn't fit, so a match is never cut short in font.filename
+    char path[sizeof(font->filename)];
+    if ((font->ttf_data = mv_ef_acquire_font_file(filename, &font->ttf_size))) {
+        snprintf(font->filename, sizeof(font->filename), "%s", filename);
+        font->face_index = face_index;
+    } else if (filename && mv_ef_find_font(filename, path, sizeof(path), &font->face_index) && 
+               (font->ttf_data = mv_ef_acquire_font_file(path, &font->ttf_size))) {
+        snprintf(font->filename, sizeof(font->filename), "%s", path);
+    } else {
+        if (filename)
+            printf("Warning: no font file or installed font matches \"%s\"\n", filename);
+
+        font->face_index = 0; // the bundled fonts only have the one face
+        for (int i = 0; i < 2 && !font->ttf_data; i++) {
+            if ((font->ttf_data = mv_ef_acquire_font_file(ttf_filenames[i], &font->ttf_size)))
+                strcpy(font->filename, ttf_filenames[i]);
+        }
+
+        if (!font->ttf_data && mv_ef_find_font("monospace, regular", path, sizeof(path), &font->face_index) && 
+            (font->ttf_data = mv_ef_acquire_font_file(path, &font->ttf_size))) {
+            snprintf(font->filename, sizeof(font->filename), "%s", path);
+        }
+
+        if (!font->ttf_data) {
+            printf("Error: can't find a valid .ttf file\n");
+            font->filename[0] = '\0';
+            return 0;
+        }
+    }
+
+    printf("Using font file: \"%s\"\n", font->filename);
+
+    // parse directly from the mapping
+    unsigned char *ttf_buffer = (unsigned char*)font->ttf_data;
+    int font_offset = font->ttf_size >= 16 ? stbtt_GetFontOffsetForIndex(ttf_buffer, font->face_index) : -1;
+    if (!mv_ef_validate_font(ttf_buffer, font->ttf_size, font_offset) || !stbtt_InitFont(&font->info, ttf_buffer, font_offset)) {
+        printf("Error: \"%s\" has no valid font with index %d\n", font->filename, font->face_index);
+        mv_ef_release_font_file(font->ttf_data, font->ttf_size);
+        font->ttf_data = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+//
+// Decodes the run-length encoding used for baked atlases.
+// a control byte c < 128 is followed by c+1 literal bytes, and c >= 128 by one byte repeated c-128+1 times
+//
+void mv_ef_rle_decompress(const unsigned char *src, int src_size, unsigned char *dst, int dst_size)
+{
+    const unsigned char *end = src + src_size;
+    unsigned char *dst_end = dst + dst_size;
+    while (src < end && dst < dst_end) {
+        int c = *src++;
+        int n = (c & 127) + 1;
+        if (dst + n > dst_end)
+            n = dst_end - dst;
+
+        if (c < 128) {
+            if (src + n > end)
+                n = end - src;
+            memcpy(dst, src, n);
+            src += n;
+        } else {
+            if (src == end)
+                break;
+            memset(dst, *src++, n);
+        }
+        dst += n;
+    }
+
+    // anything the stream didn't cover is empty
+    if (dst < dst_end)
+        memset(dst, 0, dst_end - dst);
+}
+
+//
+// Codepoint coverage
+//
+// Built once per font from its cmap (formats 4 and 12 are read directly, anything else through 
+// stbtt_FindGlyphIndex), so that picking the font for a codepoint is a couple of loads per font 
+// instead of a cmap search in each of them. Cached on disk, keyed by a hash of the cmap subtable
+//
+#define MV_EF_COVERAGE_VERSION 1
+
+static int mv_ef_covers(const mv_ef_coverage *coverage, int codepoint)
+{
+    if ((unsigned int)codepoint >= 0x110000)
+        return 0;
+
+    const unsigned char *block = coverage->blocks + 32*coverage->top[codepoint >> 8];
+    return (block[(codepoint & 255) >> 3] >> (codepoint & 7)) & 1;
+}
+
+static void mv_ef_set_coverage_range(unsigned char *bits, unsigned int first, unsigned int last)
+{
+    if (last >= 0x110000)
+        last = 0x10FFFF;
+    for (unsigned int c = first; c <= last; c++)
+        bits[c >> 3] |= 1 << (c & 7);
+}
+
+// size of the cmap subtable used by stb_truetype, 0 if it doesn't fit in the file
+static size_t mv_ef_cmap_subtable_size(const stbtt_fontinfo *info, size_t file_size)
+{
+    size_t offset = info->index_map;
+    if (offset + 8 > file_size)
+        return 0;
+
+    unsigned int format = mv_ef_read_u16(info->data + offset);
+    size_t length = format < 8 ? mv_ef_read_u16(info->data + offset + 2) : mv_ef_read_u32(info->data + offset + 4);
+    return length <= file_size - offset ? length : 0;
+}
+
+static mv_ef_coverage *mv_ef_build_coverage(const stbtt_fontinfo *info, size_t file_size)
+{
+    unsigned char *bits = (unsigned char*)MV_EF_MALLOC(0x110000/8);
+    memset(bits, 0, 0x110000/8);
+
+    const unsigned char *cmap = info->data + info->index_map;
+    size_t length = mv_ef_cmap_subtable_size(info, file_size);
+    unsigned int format = length ? mv_ef_read_u16(cmap) : 0;
+
+    if (format == 4 && length >= 14) {
+        unsigned int num_segments = mv_ef_read_u16(cmap + 6)/2;
+        if (16 + 8*num_segments <= length) {
+            const unsigned char *end_codes = cmap + 14;
+            const unsigned char *start_codes = end_codes + 2*num_segments + 2;
+            const unsigned char *deltas = start_codes + 2*num_segments;
+            const unsigned char *range_offsets = deltas + 2*num_segments;
+
+            for (unsigned int i = 0; i < num_segments; i++) {
+                unsigned int first = mv_ef_read_u16(start_codes + 2*i);
+                unsigned int last = mv_ef_read_u16(end_codes + 2*i);
+                unsigned int delta = mv_ef_read_u16(deltas + 2*i);
+                unsigned int range_offset = mv_ef_read_u16(range_offsets + 2*i);
+
+                for (unsigned int c = first; c <= last && c != 0xFFFF; c++) {
+                    unsigned int glyph;
+                    if (range_offset == 0) {
+                        glyph = (c + delta) & 0xFFFF;
+                    } else {
+                        // relative to the range offset entry itself
+                        size_t glyph_offset = (range_offsets + 2*i - cmap) + range_offset + 2*(c - first);
+                        glyph = glyph_offset + 2 <= length ? mv_ef_read_u16(cmap + glyph_offset) : 0;
+                        if (glyph)
+                            glyph = (glyph + delta) & 0xFFFF;
+                    }
+                    if (glyph)
+                        bits[c >> 3] |= 1 << (c & 7);
+                }
+            }
+        }
+    } else if ((format == 12 || format == 13) && length >= 16) {
+        unsigned int num_groups = mv_ef_read_u32(cmap + 12);
+        if (num_groups <= (length - 16)/12) {
+            for (unsigned int i = 0; i < num_groups; i++) {
+                const unsigned char *group = cmap + 16 + 12*i;
+                unsigned int first = mv_ef_read_u32(group);
+                unsigned int last = mv_ef_read_u32(group + 4);
+                unsigned int first_glyph = mv_ef_read_u32(group + 8);
+                if (first > last || first >= 0x110000)
+                    continue;
+
+                // in format 12 only the first codepoint of a group can map to glyph 0, in format 13 all of them do
+                if (first_glyph == 0) {
+                    if (format == 13)
+                        continue;
+                    first++;
+                }
+                if (first <= last)
+                    mv_ef_set_coverage_range(bits, first, last);
+            }
+        }
+    } else if (length) {
+        // the rare formats, only the basic multilingual plane
+        for (int c = 0; c < 0x10000; c++)
+            if (stbtt_FindGlyphIndex(info, c))
+                bits[c >> 3] |= 1 << (c & 7);
+    }
+
+    // deduplicate into the two-level structure
+    mv_ef_coverage *coverage = (mv_ef_coverage*)MV_EF_MALLOC(sizeof(mv_ef_coverage));
+    coverage->blocks = (unsigned char*)MV_EF_MALLOC(32*(2 + 0x110000/256));
+    memset(coverage->blocks, 0x00, 32);
+    memset(coverage->blocks + 32, 0xFF, 32);
+    coverage->num_blocks = 2;
+
+    for (int b = 0; b < 0x110000/256; b++) {
+        const unsigned char *block = bits + 32*b;
+        int index = -1;
+        for (int i = 0; i < coverage->num_blocks && index < 0; i++)
+            if (memcmp(coverage->blocks + 32*i, block, 32) == 0)
+                index = i;
+        if (index < 0) {
+            index = coverage->num_blocks++;
+            memcpy(coverage->blocks + 32*index, block, 32);
+        }
+        coverage->top[b] = (unsigned short)index;
+    }
+
+    MV_EF_FREE(bits);
+    return coverage;
+}
+
+typedef struct {
+    char magic[8]; // "mv_ef_cv"
+    unsigned int version;
+    int num_blocks;
+    unsigned long long key;
+    // followed by: unsigned short top[0x110000 >> 8], unsigned char blocks[num_blocks*32]
+} mv_ef_coverage_cache_header;
+
+static void mv_ef_free_coverage(mv_ef_coverage *coverage)
+{
+    if (coverage) {
+        MV_EF_FREE(coverage->blocks);
+        MV_EF_FREE(coverage);
+    }
+}
+
+//
+// The coverage of a font, from the disk cache or built from its cmap and then cached
+//
+static mv_ef_coverage *mv_ef_get_coverage(const stbtt_fontinfo *info, size_t file_size)
+{
+    size_t cmap_size = mv_ef_cmap_subtable_size(info, file_size);
+    unsigned long long key = mv_ef_hash(info->data + info->index_map, cmap_size, MV_EF_COVERAGE_VERSION);
+
+    char name[64], path[600];
+    snprintf(name, sizeof(name), "mv_ef_coverage_%016llx.bin", key);
+    int has_path = mv_ef_cache_path(path, sizeof(path), name);
+
+    mv_ef_coverage_cache_header header;
+    size_t top_size = sizeof(((mv_ef_coverage*)0)->top);
+    if (has_path) {
+        size_t size;
+        const unsigned char *data = mv_ef_map_file(path, &size);
+        if (data && size >= sizeof(header)) {
+            memcpy(&header, data, sizeof(header));
+            if (memcmp(header.magic, "mv_ef_cv", 8) == 0 && header.version == MV_EF_COVERAGE_VERSION && header.key == key &&
+                header.num_blocks >= 2 && size == sizeof(header) + top_size + 32*(size_t)header.num_blocks) {
+                mv_ef_coverage *coverage = (mv_ef_coverage*)MV_EF_MALLOC(sizeof(mv_ef_coverage));
+                memcpy(coverage->top, data + sizeof(header), top_size);
+                coverage->num_blocks = header.num_blocks;
+                coverage->blocks = (unsigned char*)MV_EF_MALLOC(32*header.num_blocks);
+                memcpy(coverage->blocks, data + sizeof(header) + top_size, 32*header.num_blocks);
+
+                int valid = 1;
+                for (int b = 0; b < 0x110000/256; b++)
+                    valid &= coverage->top[b] < header.num_blocks;
+
+                mv_ef_unmap_file(data, size);
+                if (valid)
+                    return coverage;
+                mv_ef_free_coverage(coverage);
+                data = NULL;
+            }
+        }
+        mv_ef_unmap_file(data, size);
+    }
+
+    mv_ef_coverage *coverage = mv_ef_build_coverage(info, file_size);
+
+    if (has_path) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "mv_ef_cv", 8);
+        header.version = MV_EF_COVERAGE_VERSION;
+        header.num_blocks = coverage->num_blocks;
+        header.key = key;
+
+        unsigned char *contents = (unsigned char*)MV_EF_MALLOC(sizeof(header) + top_size);
+        memcpy(contents, &header, sizeof(header));
+        memcpy(contents + sizeof(header), coverage->top, top_size);
+        mv_ef_write_file_atomic(path, contents, sizeof(header) + top_size, coverage->blocks, 32*coverage->num_blocks);
+        MV_EF_FREE(contents);
+    }
+
+    return coverage;
+}
+
+//
+// Adds a font to the fallback chain. returns 0 if it can't be opened
+//
+int mv_ef_ctx_add_fallback_font(mv_ef_context *ctx, const char *filename, int face_index)
+{
+    mv_ef_font *font = &ctx->font;
+    if (font->num_fallbacks >= MV_EF_MAX_FALLBACKS)
+        return 0;
+
+    mv_ef_fallback_font *fallback = &font->fallbacks[font->num_fallbacks];
+    memset(fallback, 0, sizeof(*fallback));
+
+    fallback->ttf_data = mv_ef_acquire_font_file(filename, &fallback->ttf_size);
+    if (!fallback->ttf_data)
+        return 0;
+
+    unsigned char *ttf_buffer = (unsigned char*)fallback->ttf_data;
+    int font_offset = fallback->ttf_size >= 16 ? stbtt_GetFontOffsetForIndex(ttf_buffer, face_index) : -1;
+    if (!mv_ef_validate_font(ttf_buffer, fallback->ttf_size, font_offset) || !stbtt_InitFont(&fallback->info, ttf_buffer, font_offset)) {
+        printf("Error: \"%s\" has no valid font with index %d\n", filename, face_index);
+        mv_ef_release_font_file(fallback->ttf_data, fallback->ttf_size);
+        return 0;
+    }
+
+    snprintf(fallback->filename, sizeof(fallback->filename), "%s", filename);
+    font->num_fallbacks++;
+    return 1;
+}
+
+//
+// The font that has the codepoint, the main one first and then the fallbacks in order. NULL if none has it
+//
+static const stbtt_fontinfo *mv_ef_resolve_codepoint(mv_ef_context *ctx, int codepoint)
+{
+    mv_ef_font *font = &ctx->font;
+    if (font->ttf_data) {
+        if (!font->coverage)
+            font->coverage = mv_ef_get_coverage(&font->info, font->ttf_size);
+        if (mv_ef_covers(font->coverage, codepoint))
+            return &font->info;
+    }
+
+    for (int i = 0; i < font->num_fallbacks; i++) {
+        mv_ef_fallback_font *fallback = &font->fallbacks[i];
+        if (!fallback->coverage)
+            fallback->coverage = mv_ef_get_coverage(&fallback->info, fallback->ttf_size);
+        if (mv_ef_covers(fallback->coverage, codepoint))
+            return &fallback->info;
+    }
+
+    return NULL;
+}
+
+// forgets the glyphs added on demand, for a new atlas
+static void mv_ef_reset_glyphs(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    font->num_glyphs = NUM_GLYPHS;
+    memset(font->glyph_table_keys, 0, sizeof(font->glyph_table_keys));
+    font->glyph_table_count = 0;
+    font->shelf_layer = -1;
+
+    mv_ef_free_coverage(font->coverage);
+    font->coverage = NULL;
+}
+
+// the three metadata texture rows of a glyph, see the vertex shader
+static void mv_ef_glyph_metadata(mv_ef_context *ctx, int i, float *row0, float *row1, float *row2)
+{
+    mv_ef_font *font = &ctx->font;
+    row0[0] = font->cdata[i].x0/(double)font->width;
+    row0[1] = font->cdata[i].y0/(double)font->height;
+    row0[2] = (font->cdata[i].x1-font->cdata[i].x0)/(double)font->width;
+    row0[3] = (font->cdata[i].y1-font->cdata[i].y0)/(double)font->height;
+
+    row1[0] = font->cdata[i].xoff/(double)font->width;
+    row1[1] = font->cdata[i].yoff/(double)font->height;
+    row1[2] = font->cdata[i].xoff2/(double)font->width;
+    row1[3] = font->cdata[i].yoff2/(double)font->height;
+
+    row2[0] = font->glyph_layer[i];
+    row2[1] = 0.0;
+    row2[2] = 0.0;
+    row2[3] = 0.0;
+}
+
+//
+// Makes every page of the atlas height texels tall, the glyphs staying where they are.
+// the layers of an array texture all have the same size, so it's a new texture with every page uploaded again, 
+// and the glyph metadata, which is relative to the page size, is uploaded again too
+//
+static void mv_ef_grow_atlas_pages(mv_ef_context *ctx, int height)
+{
+    mv_ef_font *font = &ctx->font;
+    size_t old_size = (size_t)font->width*font->height;
+    size_t new_size = (size_t)font->width*height;
+
+    unsigned char *bitmap = (unsigned char*)MV_EF_MALLOC(font->num_pages*new_size);
+    for (int i = 0; i < font->num_pages; i++) {
+        memcpy(bitmap + i*new_size, font->bitmap + i*old_size, old_size);
+        memset(bitmap + i*new_size + old_size, 0, new_size - old_size);
+    }
+    if (font->bitmap_mapping)
+        mv_ef_unmap_file(font->bitmap_mapping, font->bitmap_mapping_size);
+    else
+        MV_EF_FREE(font->bitmap);
+    font->bitmap = bitmap;
+    font->bitmap_mapping = NULL;
+    font->height = height;
+
+    if (ctx->headless)
+        return;
+
+    GLint last_texture;
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &last_texture);
+
+    GLuint old_texture = font->texture_fontdata;
+    font->texture_fontdata = mv_ef_create_atlas_texture(ctx, font->num_pages);
+    mv_ef_upload_atlas_layers(ctx, 0, font->num_pages);
+
+    glDeleteTextures(1, &old_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, last_texture == (GLint)old_texture ? font->texture_fontdata : (GLuint)last_texture);
+
+    float *metadata = (float*)mv_ef_temp_alloc(ctx, 12*font->num_glyphs*sizeof(float));
+    for (int i = 0; i < font->num_glyphs; i++)
+        mv_ef_glyph_metadata(ctx, i, &metadata[4*i], &metadata[4*(font->num_glyphs + i)], &metadata[4*(2*font->num_glyphs + i)]);
+
+    glActiveTexture(GL_TEXTURE1);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glBindTexture(GL_TEXTURE_2D, font->texture_metadata);
+    for (int row = 0; row < 3; row++)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, font->num_glyphs, 1, GL_RGBA, GL_FLOAT, &metadata[4*row*font->num_glyphs]);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+    glActiveTexture(GL_TEXTURE0);
+    mv_ef_temp_free(ctx, metadata);
+
+    GLint last_program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
+    glUseProgram(font->program);
+    glUniform2f(glGetUniformLocation(font->program, "res_bitmap"), font->width, font->height);
+    glUseProgram(last_program);
+}
+
+//
+// Rasterizes a glyph into a free spot of the atlas, uploads it and its metadata, and returns its slot. 
+// -1 if no font has it or there's no room
+//
+static int mv_ef_add_glyph(mv_ef_context *ctx, int codepoint)
+{
+    mv_ef_font *font = &ctx->font;
+    if (font->num_glyphs >= MV_EF_MAX_GLYPHS)
+        return -1;
+
+    const stbtt_fontinfo *info = mv_ef_resolve_codepoint(ctx, codepoint);
+    if (!info)
+        return -1;
+
+    int min_height = (MV_EF_MIN_PAGE_HEIGHT + mv_ef_atlas_height_alignment()-1) & ~(mv_ef_atlas_height_alignment()-1);
+    if (font->height < min_height)
+        mv_ef_grow_atlas_pages(ctx, min_height);
+
+    int glyph = stbtt_FindGlyphIndex(info, codepoint);
+    int ox = MV_EF_OVERSAMPLE_X, oy = MV_EF_OVERSAMPLE_Y;
+    float scale = stbtt_ScaleForPixelHeight(info, font->font_size);
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(info, glyph, scale*ox, scale*oy, &x0, &y0, &x1, &y1);
+    int w = x1 - x0 + ox-1;
+    int h = y1 - y0 + oy-1;
+
+    // shelf packing, with the same padding as the baked glyphs. a new row when the glyph doesn't fit
+    // in the current one, and a new page when the row doesn't fit in the page
+    int padding = 1 << (MV_EF_MIP_LEVELS-1);
+    if (w + 2*padding > font->width || h + 2*padding > font->height)
+        return -1;
+
+    if (font->shelf_layer >= 0 && font->shelf_x + w + 2*padding > font->width) {
+        font->shelf_x = 0;
+        font->shelf_y += font->shelf_height;
+        font->shelf_height = 0;
+    }
+    if (font->shelf_layer < 0 || font->shelf_y + h + 2*padding > font->height) {
+        int layer = mv_ef_ctx_add_atlas_page(ctx);
+        if (layer < 0)
+            return -1;
+        font->shelf_layer = layer;
+        font->shelf_x = font->shelf_y = font->shelf_height = 0;
+    }
+
+    int x = font->shelf_x + padding;
+    int y = font->shelf_y + padding;
+    font->shelf_x += w + padding;
+    if (h + padding > font->shelf_height)
+        font->shelf_height = h + padding;
+
+    // same as stbtt_PackFontRangesRenderIntoRects()
+    unsigned char *pixels = font->bitmap + (size_t)font->shelf_layer*font->width*font->height + y*font->width + x;
+    stbtt_MakeGlyphBitmapSubpixel(info, pixels, w - ox+1, h - oy+1, font->width, scale*ox, scale*oy, 0, 0, glyph);
+    if (ox > 1)
+        stbtt__h_prefilter(pixels, w, h, font->width, ox);
+    if (oy > 1)
+        stbtt__v_prefilter(pixels, w, h, font->width, oy);
+
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
+    float sub_x = stbtt__oversample_shift(ox);
+    float sub_y = stbtt__oversample_shift(oy);
+
+    int slot = font->num_glyphs++;
+    stbtt_packedchar *c = &font->cdata[slot];
+    c->x0 = x;
+    c->y0 = y;
+    c->x1 = x + w;
+    c->y1 = y + h;
+    c->xadvance = scale*advance;
+    c->xoff  = (float)x0/ox + sub_x;
+    c->yoff  = (float)y0/oy + sub_y;
+    c->xoff2 = (float)(x0 + w)/ox + sub_x;
+    c->yoff2 = (float)(y0 + h)/oy + sub_y;
+    font->glyph_layer[slot] = font->shelf_layer;
+
+    if (ctx->headless)
+        return slot;
+
+    mv_ef_ctx_update_atlas_rect(ctx, font->shelf_layer, x, y, w, h);
+
+    float metadata[12];
+    mv_ef_glyph_metadata(ctx, slot, metadata + 0, metadata + 4, metadata + 8);
+
+    GLint last_texture;
+    glActiveTexture(GL_TEXTURE1);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
+    glBindTexture(GL_TEXTURE_2D, font->texture_metadata);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, slot, 0, 1, 3, GL_RGBA, GL_FLOAT, metadata);
+    glBindTexture(GL_TEXTURE_2D, last_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    return slot;
+}
+
+//
+// The glyph slot of a codepoint, i.e. its index into font.cdata and the metadata texture. 
+// ascii is baked in, anything else is rasterized the first time it's seen, from the first 
+// font in the fallback chain that has it. codepoints no font has get the slot of '?'.
+// has to be called from the thread with the gl context, since new glyphs are uploaded right away
+//
+// the slot of a codepoint without adding it, -1 if it hasn't been seen. *index is where it goes in the table
+static int mv_ef_find_glyph_slot(const mv_ef_context *ctx, int codepoint, int *index)
+{
+    const mv_ef_font *font = &ctx->font;
+    if (codepoint >= 32 && codepoint < 32 + NUM_GLYPHS)
+        return codepoint - 32;
+    if (codepoint < 32)
+        return 0; // control characters are blank
+
+    const int table_size = 2*MV_EF_MAX_GLYPHS;
+    unsigned int h = (unsigned int)codepoint*2654435761u;
+    int i = h % table_size;
+    while (font->glyph_table_keys[i]) {
+        if (font->glyph_table_keys[i] == codepoint + 1)
+            return font->glyph_table_slots[i];
+        i = (i + 1) % table_size;
+    }
+
+    *index = i;
+    return -1;
+}
+
+int mv_ef_ctx_glyph_slot(mv_ef_context *ctx, int codepoint)
+{
+    mv_ef_font *font = &ctx->font;
+    // until the font is loaded the table belongs to the loader, and nothing can be rasterized yet. 
+    // the fallback isn't remembered, so the codepoint is looked up again once the font is ready
+    if (codepoint >= 32 + NUM_GLYPHS && !mv_ef_ctx_font_ready(ctx))
+        return '?' - 32;
+
+    int i = 0;
+    int slot = mv_ef_find_glyph_slot(ctx, codepoint, &i);
+    if (slot >= 0)
+        return slot;
+
+    // misses are remembered too, so that they aren't looked up again, and count against the same limit. 
+    // the table is at most half full. once it's full, a glyph added now couldn't be found again, 
+    // and would be rasterized into a new slot on every call
+    if (font->glyph_table_count >= MV_EF_MAX_GLYPHS)
+        return '?' - 32;
+
+    slot = mv_ef_add_glyph(ctx, codepoint);
+    if (slot < 0)
+        slot = '?' - 32;
+
+    font->glyph_table_keys[i] = codepoint + 1;
+    font->glyph_table_slots[i] = slot;
+    font->glyph_table_count++;
+    return slot;
+}
+
+//
+// Decodes one utf-8 sequence and advances the string past it. malformed sequences decode to U+FFFD
+//
+static int mv_ef_decode_utf8(const char **str)
+{
+    const unsigned char *s = (const unsigned char*)*str;
+    int length = s[0] < 0x80 ? 1 : s[0] < 0xC2 ? 0 : s[0] < 0xE0 ? 2 : s[0] < 0xF0 ? 3 : s[0] < 0xF5 ? 4 : 0;
+    if (length == 0) {
+        *str += 1;
+        return 0xFFFD;
+    }
+
+    int codepoint = length == 1 ? s[0] : s[0] & (0x7F >> length);
+    for (int i = 1; i < length; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *str += i;
+            return 0xFFFD;
+        }
+        codepoint = codepoint << 6 | (s[i] & 0x3F);
+    }
+
+    *str += length;
+    if (codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint < 0xE000))
+        return 0xFFFD;
+    return codepoint;
+}
+
+static void mv_ef_init_gl(mv_ef_context *ctx);
+
+static mv_ef_program_build mv_ef_begin_program(const char *vertex_file_path, const char *fragment_file_path);
+static int mv_ef_finish_program(mv_ef_program_build *build, int wait);
+
+//
+// Releases what the last initialization of the context loaded: the atlas (heap or mapped cache file), 
+// the font file and the opengl objects of the font. waits for an asynchronous initialization that is 
+// still running. called before a context is initialized again, and by mv_ef_destroy_context().
+// the fallback fonts stay, they are part of the context and not of the font
+//
+static void mv_ef_release_font(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+
+    if (ctx->async.pending) {
+#ifndef MV_EF_NO_THREADS
+        if (ctx->async.threaded)
+            mv_ef_thread_join(ctx->async.thread);
+#endif
+        // the program never got to the font struct
+        glDeleteShader(ctx->async.build.vs);
+        glDeleteShader(ctx->async.build.fs);
+        glDeleteProgram(ctx->async.build.program);
+        ctx->async.pending = 0;
+    }
+
+    // a context that was never initialized may not have any opengl functions loaded
+    if (font->initialized && !ctx->headless) {
+        glDeleteVertexArrays(1, &font->vao);
+        glDeleteBuffers(1, &font->vbo_quad);
+        glDeleteBuffers(1, &font->vbo_instances);
+        glDeleteTextures(1, &font->texture_fontdata);
+        glDeleteTextures(1, &font->texture_metadata);
+        glDeleteTextures(1, &font->texture_colors);
+        glDeleteProgram(font->program);
+    }
+    font->vao = font->vbo_quad = font->vbo_instances = 0;
+    font->texture_fontdata = font->texture_metadata = font->texture_colors = 0;
+    font->program = 0;
+
+    if (font->bitmap_mapping)
+        mv_ef_unmap_file(font->bitmap_mapping, font->bitmap_mapping_size);
+    else
+        MV_EF_FREE(font->bitmap);
+    font->bitmap = NULL;
+    font->bitmap_mapping = NULL;
+    font->bitmap_mapping_size = 0;
+
+    mv_ef_release_font_file(font->ttf_data, font->ttf_size);
+    font->ttf_data = NULL;
+    font->ttf_size = 0;
+    font->ready = 0;
+}
+
+//
+// The cpu side of initialization: opens the font and fills in the atlas and the metrics,
+// rasterizing the atlas unless an identical one is already cached on disk. touches no opengl state.
+// returns 0 if there is no font to load
+//
+static int mv_ef_load_font(mv_ef_context *ctx, const char *filename, int face_index, int font_size)
+{
+    mv_ef_font *font = &ctx->font;
+    double t0 = mv_ef_time_ms();
+    int opened = mv_ef_open_font(ctx, filename, face_index, font_size);
+    mv_ef_reset_glyphs(ctx);
+
+    double t1 = mv_ef_time_ms();
+    font->init_open_ms = t1 - t0;
+    font->init_raster_ms = 0.0;
+    font->init_metrics_ms = 0.0;
+    font->init_cache_ms = 0.0;
+    font->init_cache_hit = 0;
+    if (!opened)
+        return 0;
+
+    font->init_cache_hit = mv_ef_load_atlas_cache(ctx);
+    font->init_cache_ms = mv_ef_time_ms() - t1;
+
+    if (!font->init_cache_hit) {
+        mv_ef_bake_atlas(ctx);
+
+        double t2 = mv_ef_time_ms();
+        mv_ef_save_atlas_cache(ctx);
+        font->init_cache_ms += mv_ef_time_ms() - t2;
+    }
+
+    return 1;
+}
+
+//
+// Reads and compiles the shaders
+//
+// Calls stb_truetype.h routines to read and parse a .ttf file,
+// creates a bitmap that is uploaded to the gpu using opengl
+//
+// calculates and saves a bunch of useful variables and put them in the font struct of the context.
+// filename can also be a font query, see mv_ef_find_font(). returns 0 if no font could be loaded, 
+// in which case mv_ef_draw() draws nothing
+//
+int mv_ef_ctx_init(mv_ef_context *ctx, char *filename, int font_size, char *vs_filename, char *fs_filename)
+{
+    return mv_ef_ctx_init_face(ctx, filename, 0, font_size, vs_filename, fs_filename);
+}
+
+//
+// Same as mv_ef_init(), for any face of a .ttc collection. see mv_ef_num_faces()
+//
+int mv_ef_ctx_init_face(mv_ef_context *ctx, char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_release_font(ctx);
+    font->initialized = 1;
+    font->ready = 0;
+    mv_ef_arena_begin(&ctx->arena);
+
+    // the driver compiles the shaders while the atlas is rasterized below
+    double t0 = mv_ef_time_ms();
+    mv_ef_program_build build = mv_ef_begin_program(vs_filename, fs_filename);
+    font->init_shader_ms = mv_ef_time_ms() - t0;
+
+    int loaded = mv_ef_load_font(ctx, filename, face_index, font_size);
+
+    double t1 = mv_ef_time_ms();
+    mv_ef_finish_program(&build, 1);
+    font->program = build.program;
+
+    double t2 = mv_ef_time_ms();
+    font->init_shader_ms += t2 - t1;
+    if (!loaded) {
+        glDeleteProgram(font->program);
+        font->program = 0;
+        font->init_arena_used = mv_ef_arena_end(&ctx->arena);
+        return 0;
+    }
+
+    mv_ef_init_gl(ctx);
+    font->init_upload_ms = mv_ef_time_ms() - t2;
+    font->init_arena_used = mv_ef_arena_end(&ctx->arena);
+    return 1;
+}
+
+//
+// Same as mv_ef_init(), but from an atlas baked offline by bake.c, so there's
+// no file access and no .ttf parsing or rasterization at all.
+// glyphs outside the baked set can't be added later, since there is no font file.
+// returns 0 if the atlas was baked with other settings than the program is compiled with, 
+// in which case mv_ef_draw() draws nothing
+//
+int mv_ef_ctx_init_baked(mv_ef_context *ctx, const mv_ef_baked_font *baked, char *vs_filename, char *fs_filename)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_release_font(ctx);
+    font->initialized = 1;
+    font->ready = 0;
+
+    // a different layout would sample the wrong texels, and a height that isn't aligned for 
+    // MV_EF_COMPRESS_ATLAS would be compressed past the end of the atlas
+    int alignment = mv_ef_atlas_height_alignment();
+    if (baked->mip_levels != MV_EF_MIP_LEVELS || baked->oversample_x != MV_EF_OVERSAMPLE_X || baked->oversample_y != MV_EF_OVERSAMPLE_Y ||
+        baked->height % alignment != 0) {
+        printf("Error: the baked font was baked with MV_EF_MIP_LEVELS %d, MV_EF_OVERSAMPLE_X/Y %d/%d and a height alignment of %d, "
+               "the program is compiled with %d, %d/%d and %d. bake it again with the program's settings\n",
+               baked->mip_levels, baked->oversample_x, baked->oversample_y, baked->height_alignment, 
+               MV_EF_MIP_LEVELS, MV_EF_OVERSAMPLE_X, MV_EF_OVERSAMPLE_Y, alignment);
+        return 0;
+    }
+
+    mv_ef_arena_begin(&ctx->arena);
+
+    double t0 = mv_ef_time_ms();
+    mv_ef_program_build build = mv_ef_begin_program(vs_filename, fs_filename);
+    font->init_shader_ms = mv_ef_time_ms() - t0;
+
+    // nothing to open or rasterize. decoding the atlas counts as the cache lookup
+    double t1 = mv_ef_time_ms();
+    strcpy(font->filename, "(baked)");
+    font->face_index = 0;
+
+    font->font_size = baked->font_size;
+    font->width = baked->width;
+    font->height = baked->height;
+    font->page_height = baked->height;
+    font->num_pages = baked->num_pages;
+
+    font->ascent = baked->ascent;
+    font->descent = baked->descent;
+    font->linegap = baked->linegap;
+    font->linedist = font->ascent - font->descent + font->linegap;
+
+    memcpy(font->cdata, baked->cdata, NUM_GLYPHS*sizeof(stbtt_packedchar));
+    memcpy(font->glyph_layer, baked->glyph_layer, NUM_GLYPHS*sizeof(int));
+    mv_ef_reset_glyphs(ctx);
+
+    int bitmap_size = font->width*font->height*font->num_pages;
+    font->bitmap = (unsigned char*)MV_EF_MALLOC(bitmap_size);
+    font->bitmap_mapping = NULL;
+    mv_ef_rle_decompress(baked->atlas, baked->atlas_size, font->bitmap, bitmap_size);
+
+    font->init_open_ms = 0.0;
+    font->init_raster_ms = 0.0;
+    font->init_metrics_ms = 0.0;
+    font->init_cache_hit = 1;
+
+    double t2 = mv_ef_time_ms();
+    font->init_cache_ms = t2 - t1;
+    mv_ef_finish_program(&build, 1);
+    font->program = build.program;
+
+    double t3 = mv_ef_time_ms();
+    mv_ef_init_gl(ctx);
+    font->init_shader_ms += t3 - t2;
+    font->init_upload_ms = mv_ef_time_ms() - t3;
+    font->init_arena_used = mv_ef_arena_end(&ctx->arena);
+    return 1;
+}
+
+//
+// Asynchronous initialization, for programs that can't afford the startup hitch of mv_ef_init().
+// 
+// The shaders are submitted to the driver right away, and the cpu side (file mapping, packing, 
+// rasterization or the disk cache) runs on a worker thread. the opengl side is done on the render 
+// thread by the first mv_ef_draw() or mv_ef_font_ready() call after the worker is done, and only 
+// once the driver has finished the shaders. until then mv_ef_draw() draws nothing and returns 
+// immediately, and mv_ef_string_dimensions() returns 0.
+// the font struct belongs to the worker until then, and must not be touched
+//
+#ifndef MV_EF_NO_THREADS
+static MV_EF_THREAD_PROC(mv_ef_async_thread)
+{
+    mv_ef_context *ctx = (mv_ef_context*)arg;
+    ctx->async.loaded = mv_ef_load_font(ctx, ctx->async.has_filename ? ctx->async.filename : NULL, ctx->async.face_index, ctx->async.font_size);
+    mv_ef_atomic_store(&ctx->async.cpu_done, 1);
+    return 0;
+}
+#endif
+
+void mv_ef_ctx_init_async(mv_ef_context *ctx, char *filename, int font_size, char *vs_filename, char *fs_filename)
+{
+    mv_ef_ctx_init_async_face(ctx, filename, 0, font_size, vs_filename, fs_filename);
+}
+
+void mv_ef_ctx_init_async_face(mv_ef_context *ctx, char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_release_font(ctx);
+    font->initialized = 1;
+    font->ready = 0;
+    mv_ef_arena_begin(&ctx->arena); // released by mv_ef_font_ready()
+
+    double t0 = mv_ef_time_ms();
+    ctx->async.build = mv_ef_begin_program(vs_filename, fs_filename);
+    font->init_shader_ms = mv_ef_time_ms() - t0;
+    ctx->async.has_filename = filename != NULL;
+    if (filename)
+        snprintf(ctx->async.filename, sizeof(ctx->async.filename), "%s", filename);
+    ctx->async.face_index = face_index;
+    ctx->async.font_size = font_size;
+    ctx->async.pending = 1;
+    ctx->async.threaded = 0;
+    mv_ef_atomic_store(&ctx->async.cpu_done, 0);
+
+#ifndef MV_EF_NO_THREADS
+    ctx->async.threaded = mv_ef_thread_create(&ctx->async.thread, mv_ef_async_thread, ctx);
+#endif
+    if (!ctx->async.threaded) {
+        ctx->async.loaded = mv_ef_load_font(ctx, filename, face_index, font_size);
+        mv_ef_atomic_store(&ctx->async.cpu_done, 1);
+    }
+}
+
+//
+// Whether the font can be drawn. finishes an asynchronous initialization once its 
+// worker thread and the shader compile are done, without ever waiting for either
+//
+int mv_ef_ctx_font_ready(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    if (font->ready || !ctx->async.pending)
+        return font->ready;
+
+    if (!mv_ef_atomic_load(&ctx->async.cpu_done))
+        return 0;
+
+    // every poll of the shader program counts, that's what the render thread pays for it
+    double t0 = mv_ef_time_ms();
+    int status = mv_ef_finish_program(&ctx->async.build, 0);
+    font->init_shader_ms += mv_ef_time_ms() - t0;
+    if (status < 0)
+        return 0;
+
+#ifndef MV_EF_NO_THREADS
+    if (ctx->async.threaded)
+        mv_ef_thread_join(ctx->async.thread); // already done, just cleans up
+#endif
+    ctx->async.pending = 0;
+
+    font->program = ctx->async.build.program;
+    if (!ctx->async.loaded) {
+        // no font, stays not ready for good
+        glDeleteProgram(font->program);
+        font->program = 0;
+        font->init_arena_used = mv_ef_arena_end(&ctx->arena);
+        return 0;
+    }
+
+    double t1 = mv_ef_time_ms();
+    mv_ef_init_gl(ctx);
+    font->init_upload_ms = mv_ef_time_ms() - t1;
+    font->init_arena_used = mv_ef_arena_end(&ctx->arena);
+    return 1;
+}
+
+//
+// Creates all the opengl objects and uploads the atlas, once the font struct is filled in
+//
+static void mv_ef_init_gl(mv_ef_context *ctx)
+{
+    mv_ef_font *font = &ctx->font;
+    // vaos
+    glGenVertexArrays(1, &font->vao);
+    glBindVertexArray(font->vao);
+
+    // quad vbo setup, used for glyph vertex positions, 
+    // just uv coordinates that will be stretched accordingly by the glyphs width and height
+    float v[] = {0.0, 0.0, 
+                 1.0, 0.0, 
+                 0.0, 1.0,
+                 0.0, 1.0,
+                 1.0, 0.0,
+                 1.0, 1.0};
+
+    glGenBuffers(1, &font->vbo_quad);
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_quad);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,(void*)0);
+    glVertexAttribDivisor(0, 0);
+
+    // instance vbo setup.
+    // for glyph positions, glyph index and color index
+    glGenBuffers(1, &font->vbo_instances);
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1,4,GL_FLOAT,GL_FALSE,0,(void*)0);
+    glVertexAttribDivisor(1, 1);
+    //glEnable(GL_FRAMEBUFFER_SRGB); 
+    // setup and upload font bitmap texture, all pages as layers of an array texture
+    font->texture_fontdata = mv_ef_create_atlas_texture(ctx, font->num_pages);
+    mv_ef_upload_atlas_layers(ctx, 0, font->num_pages);
+
+    // setup and upload font metadata texture
+    // used for lookup in the bitmap texture    
+    glGenTextures(1, &font->texture_metadata);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, font->texture_metadata);
+
+    // room for all MV_EF_MAX_GLYPHS, the ones added on demand are filled in as they come
+    float *texture_metadata = (float*)mv_ef_temp_alloc(ctx, 12*MV_EF_MAX_GLYPHS*sizeof(float));
+    memset(texture_metadata, 0, 12*MV_EF_MAX_GLYPHS*sizeof(float));
+    
+    for (int i = 0; i < font->num_glyphs; i++) {
+        int k1 = 0*MV_EF_MAX_GLYPHS + i;
+        int k2 = 1*MV_EF_MAX_GLYPHS + i;
+        int k3 = 2*MV_EF_MAX_GLYPHS + i;
+        mv_ef_glyph_metadata(ctx, i, &texture_metadata[4*k1], &texture_metadata[4*k2], &texture_metadata[4*k3]);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, MV_EF_MAX_GLYPHS, 3, 0, GL_RGBA, GL_FLOAT, texture_metadata);
+
+    mv_ef_temp_free(ctx, texture_metadata);
+
+    // setup color texture
+    //glUniform3fv(glGetUniformLocation(font.program, "colors"), 9, mv_ef_colors);
+
+    glGenTextures(1, &font->texture_colors);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_1D, font->texture_colors);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, mv_ef_num_colors, 0, GL_RGB, GL_UNSIGNED_BYTE, ctx->colors);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+
+    // upload constant uniforms
+    glUseProgram(font->program);
+    glUniform1i(glGetUniformLocation(font->program, "sampler_font"), 0);
+    glUniform1i(glGetUniformLocation(font->program, "sampler_meta"), 1);
+    glUniform1i(glGetUniformLocation(font->program, "sampler_colors"), 2);
+    glUniform1i(glGetUniformLocation(font->program, "sampler_world"), 3);
+
+    GLuint world_block = glGetUniformBlockIndex(font->program, "mv_ef_world");
+    if (world_block != GL_INVALID_INDEX)
+        glUniformBlockBinding(font->program, world_block, MV_EF_WORLD_BINDING);
+
+    glUniform2f(glGetUniformLocation(font->program, "res_bitmap"), font->width, font->height);
+    glUniform2f(glGetUniformLocation(font->program, "res_meta"),  MV_EF_MAX_GLYPHS, 3);
+    glUniform1f(glGetUniformLocation(font->program, "num_colors"),  mv_ef_num_colors);
+    glUniform1f(glGetUniformLocation(font->program, "offset_firstline"), font->linedist-font->linegap);
+
+    font->ready = 1;
+}
+
+//
+// Lays out a string as glyph instances (x, y, slot, color) in t, starting at (x0, y0), 
+// and returns the number of glyphs. with add_glyphs, glyphs it hasn't seen before are rasterized, 
+// see mv_ef_glyph_slot(), otherwise they are drawn as '?' and the context is only read
+//
+static int mv_ef_layout_string(mv_ef_context *ctx, const char *str, const char *col, float x0, float y0, float size, int add_glyphs, float *t)
+{
+    mv_ef_font *font = &ctx->font;
+    // parse string, convert to vbo data
+    float X = x0;
+    float Y = y0;
+    float l = font->linedist*size/font->font_size;
+
+    float advances[96];
+    for (int i = 0; i < 96; i++)
+        advances[i] = font->cdata[i].xadvance*size/font->font_size;
+
+    // utf-8. glyphs outside ascii get a slot the first time they're seen, see mv_ef_glyph_slot()
+    float *t0 = t;
+    for (const char *c = str; *c; ) {
+        const char *start = c;
+        int codepoint = (unsigned char)*c < 0x80 ? *c++ : mv_ef_decode_utf8(&c);
+
+        if (codepoint == '\n') {
+            X = x0;
+            Y -= l;
+            continue;
+        }
+
+        int index;
+        int slot = add_glyphs ? mv_ef_ctx_glyph_slot(ctx, codepoint) : mv_ef_find_glyph_slot(ctx, codepoint, &index);
+        if (slot < 0)
+            slot = '?' - 32;
+        float dx = slot < 96 ? advances[slot] : font->cdata[slot].xadvance*size/font->font_size;
+
+        *t++ = X;
+        *t++ = Y;
+        *t++ = slot;
+        *t++ = col ? col[start-str] : 0; // the color of the first byte
+
+        X += dx;
+    }
+    return (t - t0)/4;
+}
+
+// the opengl state mv_ef_draw() changes, restored when it's done
+typedef struct {
+    GLint program, vertex_array; 
+    GLint texture0, texture1, texture2; 
+    GLint blend_src, blend_dst; 
+    GLint blend_equation_rgb, blend_equation_alpha; 
+    GLboolean enable_blend, enable_depth_test;
+} mv_ef_gl_state;
+
+// backs up the opengl state and binds everything the font is drawn with
+static void mv_ef_begin_draw(mv_ef_context *ctx, mv_ef_gl_state *last)
+{
+    mv_ef_font *font = &ctx->font;
+    // Backup GL state
+    glGetIntegerv(GL_CURRENT_PROGRAM, &last->program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last->vertex_array);
+
+    glActiveTexture(GL_TEXTURE0); 
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &last->texture0);
+    glActiveTexture(GL_TEXTURE1); 
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last->texture1);
+    glActiveTexture(GL_TEXTURE2); 
+    glGetIntegerv(GL_TEXTURE_BINDING_1D, &last->texture2);
+
+    glGetIntegerv(GL_BLEND_SRC, &last->blend_src);
+    glGetIntegerv(GL_BLEND_DST, &last->blend_dst);
+    glGetIntegerv(GL_BLEND_EQUATION_RGB,   &last->blend_equation_rgb);
+    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &last->blend_equation_alpha);
+
+    last->enable_blend      = glIsEnabled(GL_BLEND);
+    last->enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    // Setup render state: alpha-blending enabled, no depth testing and bind textures
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, font->texture_fontdata);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, font->texture_metadata);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_1D, font->texture_colors);
+
+    // update bindings
+    glBindVertexArray(font->vao);
+    glVertexAttrib1f(2, 1.0f); // instanceScale, unless the labels enable its array
+
+    // update uniforms
+    glUseProgram(font->program);
+    
+    GLint dims[4] = {0};
+    glGetIntegerv(GL_VIEWPORT, dims);
+    glUniform2f(glGetUniformLocation(font->program, "resolution"), dims[2], dims[3]);
+}
+
+static void mv_ef_end_draw(const mv_ef_gl_state *last)
+{
+    // Restore modified GL state
+    glUseProgram(last->program);
+    
+    glActiveTexture(GL_TEXTURE0); 
+    glBindTexture(GL_TEXTURE_2D_ARRAY, last->texture0);
+    glActiveTexture(GL_TEXTURE1); 
+    glBindTexture(GL_TEXTURE_2D, last->texture1);
+    glActiveTexture(GL_TEXTURE2); 
+    glBindTexture(GL_TEXTURE_1D, last->texture2);
+
+    glBlendEquationSeparate(last->blend_equation_rgb, last->blend_equation_alpha);
+    glBindVertexArray(last->vertex_array);
+    glBlendFunc(last->blend_src, last->blend_dst);
+    
+    (last->enable_depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST));
+    (last->enable_blend ? glEnable(GL_BLEND) : glDisable(GL_BLEND));
+}
+
+// 
+// draw a string
+// 
+// will call mv_ef_init() if it's the first time it's called. 
+// can optionally call this manually
+//
+// will parse the string and update the instance vbo, then upload it
+//
+// finally draws
+// 
+void mv_ef_ctx_draw(mv_ef_context *ctx, char *str, char *col, float offset[2], float size) 
+{
+    mv_ef_font *font = &ctx->font;
+
+    if (font->initialized == 0) {
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+    }
+
+    // still loading in the background, skip the text instead of stalling the frame
+    if (!mv_ef_ctx_font_ready(ctx))
+        return;
+
+    int len = strlen(str);
+
+    if (len > MAX_STRING_LEN) {
+        printf("Error: string too long. Returning\n");
+        return;
+    } 
+
+    if (!ctx->glyph_data)
+        ctx->glyph_data = (float*)MV_EF_MALLOC(4*MAX_STRING_LEN*sizeof(float));
+
+    int ctr = mv_ef_layout_string(ctx, str, col, 0.0, 0.0, size, 1, ctx->glyph_data);
+
+    mv_ef_gl_state last;
+    mv_ef_begin_draw(ctx, &last);
+
+    glUniform1f(glGetUniformLocation(font->program, "scale_factor"), size/font->font_size);
+    glUniform2fv(glGetUniformLocation(font->program, "string_offset"), 1, offset);
+
+    // actual uploading
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, 4*4*ctr, ctx->glyph_data);
+
+
+    // actual drawing
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, ctr);
+
+    mv_ef_end_draw(&last);
+}
+
+//
+// Maps the instance buffer for writing count glyphs, up to MAX_STRING_LEN, for mv_ef_ctx_unmap_and_draw().
+// the previous contents are invalidated, so the driver can hand out fresh memory instead of waiting for 
+// draws still reading the buffer. returns NULL while the font isn't ready, and for headless contexts.
+// the memory is write-only and may be uncached, so write every record once, in order, and don't read it.
+// nothing else may draw with the context until mv_ef_ctx_unmap_and_draw()
+//
+mv_ef_instance *mv_ef_ctx_map_instances(mv_ef_context *ctx, int count)
+{
+    mv_ef_font *font = &ctx->font;
+
+    if (font->initialized == 0) {
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+    }
+
+    if (!mv_ef_ctx_font_ready(ctx) || ctx->headless || count <= 0)
+        return NULL;
+
+    if (count > MAX_STRING_LEN) {
+        printf("Error: too many instances. Returning\n");
+        return NULL;
+    }
+
+    if (ctx->mapped_instances > 0) {
+        printf("Error: instances are already mapped. Returning\n");
+        return NULL;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+    void *instances = glMapBufferRange(GL_ARRAY_BUFFER, 0, count*sizeof(mv_ef_instance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!instances)
+        return NULL;
+
+    ctx->mapped_instances = count;
+    return (mv_ef_instance*)instances;
+}
+
+// unmaps the instances of mv_ef_ctx_map_instances() and draws them like mv_ef_draw() would draw a string
+void mv_ef_ctx_unmap_and_draw(mv_ef_context *ctx, float offset[2], float size)
+{
+    mv_ef_font *font = &ctx->font;
+    int count = ctx->mapped_instances;
+    if (count <= 0)
+        return;
+    ctx->mapped_instances = 0;
+
+    // the contents are undefined if the driver lost them meanwhile, e.g. on a mode switch
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+    if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+        return;
+
+    mv_ef_gl_state last;
+    mv_ef_begin_draw(ctx, &last);
+
+    glUniform1f(glGetUniformLocation(font->program, "scale_factor"), size/font->font_size);
+    glUniform2fv(glGetUniformLocation(font->program, "string_offset"), 1, offset);
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+
+    mv_ef_end_draw(&last);
+}
+
+//
+// Labels
+//
+// All labels are laid out into one stream of instances, with each label's origin added to the positions 
+// of its glyphs, and its size relative to the atlas in a second per instance attribute, instanceScale, 
+// so the whole stream is drawn in one draw call per MAX_STRING_LEN glyphs. 
+//
+// The labels are split into runs of about the same number of bytes, and every run is laid out by its own 
+// thread, starting at the instance of its first byte as if every byte were a glyph. the gaps that 
+// multi-byte characters and line breaks leave at the ends of the runs are closed afterwards
+//
+#ifndef MV_EF_LABEL_RUN_BYTES
+#define MV_EF_LABEL_RUN_BYTES 16384 // at least this much text per layout thread
+#endif
+
+typedef struct {
+    mv_ef_context *ctx;
+    const mv_ef_label *labels;
+    int begin, end; // labels of the run
+    int start;      // first instance, the bytes of the labels before it
+    int count;      // instances laid out
+    int add_glyphs; // see mv_ef_layout_string()
+    int world;      // also store the label of every instance, for mv_ef_ctx_draw_world_labels()
+} mv_ef_label_run;
+
+static void mv_ef_layout_label_run(mv_ef_label_run *run)
+{
+    mv_ef_context *ctx = run->ctx;
+    float *t = ctx->label_instances + 4*run->start;
+    float *scales = ctx->label_scales + run->start;
+    float *indices = ctx->label_indices + run->start;
+
+    int count = 0;
+    for (int i = run->begin; i < run->end; i++) {
+        const mv_ef_label *label = &run->labels[i];
+        int n = mv_ef_layout_string(ctx, label->text, label->col, label->x, label->y, label->size, run->add_glyphs, t + 4*count);
+        for (int j = count; j < count + n; j++) {
+            if (!label->col)
+                t[4*j + 3] = label->color;
+            scales[j] = label->size/ctx->font.font_size;
+            if (run->world)
+                indices[j] = i;
+        }
+        count += n;
+    }
+    run->count = count;
+}
+
+#ifndef MV_EF_NO_THREADS
+static MV_EF_THREAD_PROC(mv_ef_label_thread)
+{
+    mv_ef_layout_label_run((mv_ef_label_run*)arg);
+    return 0;
+}
+#endif
+
+// lays the labels out into label_instances, label_scales and with world label_indices, returns the number of instances
+static int mv_ef_layout_labels(mv_ef_context *ctx, const mv_ef_label *labels, int num_labels, int world)
+{
+    // every byte could be a glyph
+    int num_bytes = 0;
+    for (int i = 0; i < num_labels; i++)
+        num_bytes += strlen(labels[i].text);
+    if (num_bytes == 0)
+        return 0;
+
+    if (num_bytes > ctx->label_capacity) {
+        ctx->label_instances = (float*)MV_EF_REALLOC(ctx->label_instances, 4*num_bytes*sizeof(float));
+        ctx->label_scales = (float*)MV_EF_REALLOC(ctx->label_scales, num_bytes*sizeof(float));
+        ctx->label_indices = (float*)MV_EF_REALLOC(ctx->label_indices, num_bytes*sizeof(float));
+        ctx->label_capacity = num_bytes;
+    }
+
+    int num_runs = 1;
+#ifndef MV_EF_NO_THREADS
+    num_runs = num_bytes/MV_EF_LABEL_RUN_BYTES;
+    if (num_runs > mv_ef_num_cpus()) num_runs = mv_ef_num_cpus();
+    if (num_runs > MV_EF_MAX_THREADS) num_runs = MV_EF_MAX_THREADS;
+    if (num_runs > num_labels) num_runs = num_labels;
+    if (num_runs < 1) num_runs = 1;
+#endif
+
+    // with several threads, glyphs that haven't been seen yet are added up front, since that may upload 
+    // to the atlas, and the threads only look them up
+    if (num_runs > 1) {
+        for (int i = 0; i < num_labels; i++) {
+            for (const char *c = labels[i].text; *c; ) {
+                if ((unsigned char)*c < 0x80) {
+                    c++;
+                    continue;
+                }
+                mv_ef_ctx_glyph_slot(ctx, mv_ef_decode_utf8(&c));
+            }
+        }
+    }
+
+    mv_ef_label_run runs[MV_EF_MAX_THREADS];
+    int label = 0, bytes = 0;
+    for (int r = 0; r < num_runs; r++) {
+        mv_ef_label_run *run = &runs[r];
+        run->ctx = ctx;
+        run->labels = labels;
+        run->begin = label;
+        run->start = bytes;
+        run->add_glyphs = num_runs == 1;
+        run->world = world;
+
+        // up to this run's share of the bytes, the last run takes the rest
+        long long share = (long long)num_bytes*(r + 1)/num_runs;
+        while (label < num_labels && (bytes < share || r == num_runs - 1))
+            bytes += strlen(labels[label++].text);
+        run->end = label;
+    }
+
+#ifndef MV_EF_NO_THREADS
+    mv_ef_thread threads[MV_EF_MAX_THREADS];
+    int started[MV_EF_MAX_THREADS] = {0};
+    for (int r = 1; r < num_runs; r++)
+        started[r] = mv_ef_thread_create(&threads[r], mv_ef_label_thread, &runs[r]);
+    mv_ef_layout_label_run(&runs[0]);
+    for (int r = 1; r < num_runs; r++) {
+        if (started[r])
+            mv_ef_thread_join(threads[r]);
+        else
+            mv_ef_layout_label_run(&runs[r]);
+    }
+#else
+    mv_ef_layout_label_run(&runs[0]);
+#endif
+
+    // close the gaps between the runs
+    int num_instances = runs[0].count;
+    for (int r = 1; r < num_runs; r++) {
+        memmove(ctx->label_instances + 4*num_instances, ctx->label_instances + 4*runs[r].start, 4*runs[r].count*sizeof(float));
+        memmove(ctx->label_scales + num_instances, ctx->label_scales + runs[r].start, runs[r].count*sizeof(float));
+        if (world)
+            memmove(ctx->label_indices + num_instances, ctx->label_indices + runs[r].start, runs[r].count*sizeof(float));
+        num_instances += runs[r].count;
+    }
+    return num_instances;
+}
+
+// one more vbo for a per instance attribute of the labels, MAX_STRING_LEN floats
+static void mv_ef_label_attribute(GLuint *vbo, GLuint index)
+{
+    if (!*vbo) {
+        glGenBuffers(1, vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+    }
+
+    // only enabled for the labels, every other draw gets the constant from mv_ef_begin_draw()
+    glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+    glVertexAttribPointer(index, 1, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glVertexAttribDivisor(index, 1);
+    glEnableVertexAttribArray(index);
+}
+
+// draws the laid out labels, inside mv_ef_begin_draw() and mv_ef_end_draw()
+static void mv_ef_draw_label_instances(mv_ef_context *ctx, int num_instances, int world)
+{
+    mv_ef_font *font = &ctx->font;
+
+    mv_ef_label_attribute(&ctx->vbo_label_scales, 2);
+    if (world)
+        mv_ef_label_attribute(&ctx->vbo_label_indices, 3);
+
+    // uploaded in pieces the size of the instance vbo, orphaning the buffers after the first piece
+    for (int first = 0; first < num_instances; first += MAX_STRING_LEN) {
+        int count = num_instances - first < MAX_STRING_LEN ? num_instances - first : MAX_STRING_LEN;
+
+        glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+        if (first > 0)
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*4*count, ctx->label_instances + 4*first);
+
+        glBindBuffer(GL_ARRAY_BUFFER, ctx->vbo_label_scales);
+        if (first > 0)
+            glBufferData(GL_ARRAY_BUFFER, sizeof(float)*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*count, ctx->label_scales + first);
+
+        if (world) {
+            glBindBuffer(GL_ARRAY_BUFFER, ctx->vbo_label_indices);
+            if (first > 0)
+                glBufferData(GL_ARRAY_BUFFER, sizeof(float)*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*count, ctx->label_indices + first);
+        }
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+    }
+
+    glDisableVertexAttribArray(2);
+    if (world)
+        glDisableVertexAttribArray(3);
+}
+
+void mv_ef_ctx_draw_labels(mv_ef_context *ctx, const mv_ef_label *labels, int num_labels)
+{
+    mv_ef_font *font = &ctx->font;
+
+    if (font->initialized == 0) {
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+    }
+
+    if (!mv_ef_ctx_font_ready(ctx) || num_labels <= 0)
+        return;
+
+    int num_instances = mv_ef_layout_labels(ctx, labels, num_labels, 0);
+    if (num_instances == 0)
+        return;
+
+    mv_ef_gl_state last;
+    mv_ef_begin_draw(ctx, &last);
+
+    float no_offset[2] = {0.0, 0.0}; // already in the instances
+    glUniform2fv(glGetUniformLocation(font->program, "string_offset"), 1, no_offset);
+    glUniform1f(glGetUniformLocation(font->program, "scale_factor"), 1.0);
+
+    mv_ef_draw_label_instances(ctx, num_instances, 0);
+
+    mv_ef_end_draw(&last);
+}
+
+//
+// World space labels
+//
+// Laid out like mv_ef_ctx_draw_labels(), with each label's offset as its origin, and a third per instance 
+// attribute, instanceLabel, the index of the label. the vertex shader looks up the label's model matrix 
+// and billboard flag by it in the label table, a texture buffer of 5 RGBA32F texels per label, and projects 
+// with the matrix of the uniform block mv_ef_world, bound to MV_EF_WORLD_BINDING during the draw
+//
+
+void mv_ef_ctx_set_view_projection(mv_ef_context *ctx, const float view_projection[16])
+{
+    if (ctx->headless)
+        return;
+
+    if (!ctx->ubo_world)
+        glGenBuffers(1, &ctx->ubo_world);
+    glBindBuffer(GL_UNIFORM_BUFFER, ctx->ubo_world);
+    glBufferData(GL_UNIFORM_BUFFER, 16*sizeof(float), view_projection, GL_DYNAMIC_DRAW);
+}
+
+void mv_ef_ctx_draw_world_labels(mv_ef_context *ctx, const mv_ef_world_label *labels, int num_labels, int depth_test)
+{
+    mv_ef_font *font = &ctx->font;
+
+    if (font->initialized == 0) {
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+    }
+
+    if (!mv_ef_ctx_font_ready(ctx) || num_labels <= 0)
+        return;
+
+    if (!ctx->ubo_world) {
+        printf("Error: no view projection matrix, see mv_ef_set_view_projection(). Returning\n");
+        return;
+    }
+
+    // the labels in their own planes, and their table
+    if (num_labels > ctx->world_capacity) {
+        ctx->world_labels = (mv_ef_label*)MV_EF_REALLOC(ctx->world_labels, num_labels*sizeof(mv_ef_label));
+        ctx->world_table = (float*)MV_EF_REALLOC(ctx->world_table, 20*num_labels*sizeof(float));
+        ctx->world_capacity = num_labels;
+    }
+    for (int i = 0; i < num_labels; i++) {
+        const mv_ef_world_label *label = &labels[i];
+        mv_ef_label *plane = &ctx->world_labels[i];
+        plane->text = label->text;
+        plane->col = label->col;
+        plane->color = label->color;
+        plane->x = label->offset[0];
+        plane->y = label->offset[1];
+        plane->size = label->size;
+
+        float *entry = ctx->world_table + 20*i;
+        memcpy(entry, label->transform, 16*sizeof(float));
+        entry[16] = label->billboard ? 1.0f : 0.0f;
+        entry[17] = entry[18] = entry[19] = 0.0f;
+    }
+
+    int num_instances = mv_ef_layout_labels(ctx, ctx->world_labels, num_labels, 1);
+    if (num_instances == 0)
+        return;
+
+    if (!ctx->texture_world_table) {
+        glGenBuffers(1, &ctx->tbo_world_table);
+        glGenTextures(1, &ctx->texture_world_table);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, ctx->tbo_world_table);
+    glBufferData(GL_TEXTURE_BUFFER, 20*num_labels*sizeof(float), ctx->world_table, GL_STREAM_DRAW);
+
+    mv_ef_gl_state last;
+    mv_ef_begin_draw(ctx, &last);
+
+    // the rest of the state the world labels change
+    GLint last_texture3, last_ubo, last_ubo_start, last_ubo_size;
+    GLboolean last_depth_mask;
+    glActiveTexture(GL_TEXTURE3);
+    glGetIntegerv(GL_TEXTURE_BINDING_BUFFER, &last_texture3);
+    glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, MV_EF_WORLD_BINDING, &last_ubo);
+    glGetIntegeri_v(GL_UNIFORM_BUFFER_START, MV_EF_WORLD_BINDING, &last_ubo_start);
+    glGetIntegeri_v(GL_UNIFORM_BUFFER_SIZE, MV_EF_WORLD_BINDING, &last_ubo_size);
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &last_depth_mask);
+
+    glBindTexture(GL_TEXTURE_BUFFER, ctx->texture_world_table);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, ctx->tbo_world_table);
+    glBindBufferBase(GL_UNIFORM_BUFFER, MV_EF_WORLD_BINDING, ctx->ubo_world);
+
+    // tested against the scene, but glyphs are blended and don't hide each other
+    if (depth_test) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+    }
+
+    float no_offset[2] = {0.0, 0.0};
+    glUniform2fv(glGetUniformLocation(font->program, "string_offset"), 1, no_offset);
+    glUniform1f(glGetUniformLocation(font->program, "scale_factor"), 1.0);
+    GLint world_space = glGetUniformLocation(font->program, "world_space");
+    glUniform1f(world_space, 1.0);
+
+    mv_ef_draw_label_instances(ctx, num_instances, 1);
+
+    glUniform1f(world_space, 0.0);
+
+    glDepthMask(last_depth_mask);
+    if (last_ubo_size > 0)
+        glBindBufferRange(GL_UNIFORM_BUFFER, MV_EF_WORLD_BINDING, last_ubo, last_ubo_start, last_ubo_size);
+    else
+        glBindBufferBase(GL_UNIFORM_BUFFER, MV_EF_WORLD_BINDING, last_ubo);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, last_texture3);
+
+    mv_ef_end_draw(&last);
+}
+
+//
+// Deletes everything a context owns: its opengl objects, the atlas, the font files it holds 
+// and its buffers. waits for an asynchronous initialization that is still running.
+// the default context is only emptied, and can be initialized again
+//
+void mv_ef_destroy_context(mv_ef_context *ctx)
+{
+    if (!ctx)
+        return;
+    mv_ef_font *font = &ctx->font;
+    mv_ef_release_font(ctx);
+
+    if (!ctx->headless) {
+        glDeleteBuffers(1, &ctx->vbo_label_scales);
+        glDeleteBuffers(1, &ctx->vbo_label_indices);
+        glDeleteBuffers(1, &ctx->tbo_world_table);
+        glDeleteTextures(1, &ctx->texture_world_table);
+        glDeleteBuffers(1, &ctx->ubo_world);
+
+        for (int i = 0; i < MV_EF_PBO_RING_SIZE; i++) {
+            mv_ef_pbo *pbo = &ctx->pbo_ring.pbos[i];
+            if (pbo->fence)
+                glDeleteSync(pbo->fence);
+            glDeleteBuffers(1, &pbo->buffer);
+        }
+    }
+
+    mv_ef_free_coverage(font->coverage);
+    for (int i = 0; i < font->num_fallbacks; i++) {
+        mv_ef_release_font_file(font->fallbacks[i].ttf_data, font->fallbacks[i].ttf_size);
+        mv_ef_free_coverage(font->fallbacks[i].coverage);
+    }
+
+    MV_EF_FREE(ctx->glyph_data);
+    MV_EF_FREE(ctx->label_instances);
+    MV_EF_FREE(ctx->label_scales);
+    MV_EF_FREE(ctx->label_indices);
+    MV_EF_FREE(ctx->world_labels);
+    MV_EF_FREE(ctx->world_table);
+    if (ctx->arena.base)
+        mv_ef_arena_end(&ctx->arena);
+
+    if (ctx == &mv_ef_default)
+        memset(ctx, 0, sizeof(*ctx));
+    else
+        MV_EF_FREE(ctx);
+}
+
+//
+// The functions without a context, on the default one
+//
+int mv_ef_init(char *filename, int font_size, char *vs_filename, char *fs_filename)
+{
+    return mv_ef_ctx_init(mv_ef_default_context(), filename, font_size, vs_filename, fs_filename);
+}
+
+int mv_ef_init_face(char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename)
+{
+    return mv_ef_ctx_init_face(mv_ef_default_context(), filename, face_index, font_size, vs_filename, fs_filename);
+}
+
+int mv_ef_init_baked(const mv_ef_baked_font *baked, char *vs_filename, char *fs_filename)
+{
+    return mv_ef_ctx_init_baked(mv_ef_default_context(), baked, vs_filename, fs_filename);
+}
+
+void mv_ef_init_async(char *filename, int font_size, char *vs_filename, char *fs_filename)
+{
+    mv_ef_ctx_init_async(mv_ef_default_context(), filename, font_size, vs_filename, fs_filename);
+}
+
+void mv_ef_init_async_face(char *filename, int face_index, int font_size, char *vs_filename, char *fs_filename)
+{
+    mv_ef_ctx_init_async_face(mv_ef_default_context(), filename, face_index, font_size, vs_filename, fs_filename);
+}
+
+int mv_ef_add_fallback_font(const char *filename, int face_index)
+{
+    return mv_ef_ctx_add_fallback_font(mv_ef_default_context(), filename, face_index);
+}
+
+int mv_ef_glyph_slot(int codepoint)
+{
+    return mv_ef_ctx_glyph_slot(mv_ef_default_context(), codepoint);
+}
+
+int mv_ef_font_ready()
+{
+    return mv_ef_ctx_font_ready(mv_ef_default_context());
+}
+
+mv_ef_instance *mv_ef_map_instances(int count)
+{
+    return mv_ef_ctx_map_instances(mv_ef_default_context(), count);
+}
+
+void mv_ef_unmap_and_draw(float offset[2], float size)
+{
+    mv_ef_ctx_unmap_and_draw(mv_ef_default_context(), offset, size);
+}
+
+void mv_ef_draw_labels(const mv_ef_label *labels, int num_labels)
+{
+    mv_ef_ctx_draw_labels(mv_ef_default_context(), labels, num_labels);
+}
+
+void mv_ef_set_view_projection(const float view_projection[16])
+{
+    mv_ef_ctx_set_view_projection(mv_ef_default_context(), view_projection);
+}
+
+void mv_ef_draw_world_labels(const mv_ef_world_label *labels, int num_labels, int depth_test)
+{
+    mv_ef_ctx_draw_world_labels(mv_ef_default_context(), labels, num_labels, depth_test);
+}
+
+void mv_ef_draw(char *str, char *col, float offset[2], float size)
+{
+    mv_ef_ctx_draw(mv_ef_default_context(), str, col, offset, size);
+}
+
+void mv_ef_string_dimensions(char *str, float *width, float *height, int font_size)
+{
+    mv_ef_ctx_string_dimensions(mv_ef_default_context(), str, width, height, font_size);
+}
+
+void mv_ef_set_colors(unsigned char *colors)
+{
+    mv_ef_ctx_set_colors(mv_ef_default_context(), colors);
+}
+
+unsigned char *mv_ef_get_colors(int *num_colors)
+{
+    return mv_ef_ctx_get_colors(mv_ef_default_context(), num_colors);
+}
+
+int mv_ef_add_atlas_page()
+{
+    return mv_ef_ctx_add_atlas_page(mv_ef_default_context());
+}
+
+void mv_ef_update_atlas_rect(int layer, int x, int y, int width, int height)
+{
+    mv_ef_ctx_update_atlas_rect(mv_ef_default_context(), layer, x, y, width, height);
+}
+
+mv_ef_font *mv_ef_get_font()
+{
+    return mv_ef_ctx_get_font(mv_ef_default_context());
+}
+
+
+//
+// Frame command queue
+//
+// Every producer has a buffer per frame parity, so a producer records frame N+1 into one while the render
+// thread draws frame N from the other. the only shared state is the frame counter: a producer marks 
+// itself active in the frame it's recording into before it touches the buffer, and the render thread 
+// ends a frame by incrementing the counter and waiting for the producers still active in the old frame, 
+// which at most takes the time of copying one string. producers never wait.
+//
+// mv_ef_queue_submit() lays out all the text of the frame into one instance buffer, uploads it once and 
+// draws it with one draw call per run of text of the same size, inside one backup and restore of the opengl state
+//
+#ifndef MV_EF_MAX_PRODUCERS
+#define MV_EF_MAX_PRODUCERS 64
+#endif
+
+typedef struct {
+    float offset[2];
+    float size;
+    int len;
+    const char *str, *col; // referenced text, or NULL when it's copied
+    size_t text;           // offset of the copied string in the frame's text, followed by the colors if has_col
+    int has_col;
+} mv_ef_queue_command;
+
+typedef struct {
+    mv_ef_queue_command *commands;
+    int num_commands, max_commands;
+    char *text;
+    size_t text_size, max_text;
+} mv_ef_queue_frame;
+
+struct mv_ef_producer {
+    mv_ef_queue *queue;
+    volatile long active; // frame+1 while a command is being recorded into it, 0 otherwise
+    mv_ef_queue_frame frames[2];
+};
+
+// glyphs of the same size, drawn with one call
+typedef struct {
+    int first, count;
+    float size;
+} mv_ef_queue_run;
+
+struct mv_ef_queue {
+    mv_ef_context *ctx;
+    volatile long frame;
+    volatile long num_producers;
+    mv_ef_producer producers[MV_EF_MAX_PRODUCERS];
+
+    // the render thread's side
+    float *instances;
+    int max_instances;
+    mv_ef_queue_run *runs;
+    int num_runs, max_runs;
+};
+
+mv_ef_queue *mv_ef_create_queue(mv_ef_context *ctx)
+{
+    mv_ef_queue *queue = (mv_ef_queue*)MV_EF_MALLOC(sizeof(mv_ef_queue));
+    memset(queue, 0, sizeof(*queue));
+    queue->ctx = ctx;
+    for (int i = 0; i < MV_EF_MAX_PRODUCERS; i++)
+        queue->producers[i].queue = queue;
+    return queue;
+}
+
+// no producer may be recording anymore
+void mv_ef_destroy_queue(mv_ef_queue *queue)
+{
+    if (!queue)
+        return;
+
+    for (int i = 0; i < MV_EF_MAX_PRODUCERS; i++) {
+        for (int j = 0; j < 2; j++) {
+            MV_EF_FREE(queue->producers[i].frames[j].commands);
+            MV_EF_FREE(queue->producers[i].frames[j].text);
+        }
+    }
+    MV_EF_FREE(queue->instances);
+    MV_EF_FREE(queue->runs);
+    MV_EF_FREE(queue);
+}
+
+//
+// A producer buffer for the calling thread, to record into from that thread only. 
+// NULL once MV_EF_MAX_PRODUCERS are handed out
+//
+mv_ef_producer *mv_ef_queue_producer(mv_ef_queue *queue)
+{
+    long index = mv_ef_atomic_add(&queue->num_producers, 1);
+    if (index >= MV_EF_MAX_PRODUCERS) {
+        printf("Error: more than %d producers for a queue\n", MV_EF_MAX_PRODUCERS);
+        return NULL;
+    }
+    return &queue->producers[index];
+}
+
+//
+// Marks the producer active in the current frame and returns that frame's buffer. 
+// if the render thread ends the frame in between, the producer moves on to the next one
+//
+static mv_ef_queue_frame *mv_ef_begin_record(mv_ef_producer *producer)
+{
+    for (;;) {
+        long frame = mv_ef_atomic_load(&producer->queue->frame);
+        mv_ef_atomic_exchange(&producer->active, frame + 1);
+        if (mv_ef_atomic_add(&producer->queue->frame, 0) == frame)
+            return &producer->frames[frame & 1];
+    }
+}
+
+static void mv_ef_end_record(mv_ef_producer *producer)
+{
+    mv_ef_atomic_store(&producer->active, 0);
+}
+
+static void mv_ef_record_text(mv_ef_producer *producer, const char *str, const char *col, float offset[2], float size, int copy)
+{
+    if (!producer || !str)
+        return;
+
+    int len = strlen(str);
+    mv_ef_queue_frame *f = mv_ef_begin_record(producer);
+
+    if (f->num_commands == f->max_commands) {
+        f->max_commands = f->max_commands ? 2*f->max_commands : 64;
+        f->commands = (mv_ef_queue_command*)MV_EF_REALLOC(f->commands, f->max_commands*sizeof(mv_ef_queue_command));
+    }
+
+    mv_ef_queue_command *command = &f->commands[f->num_commands++];
+    command->offset[0] = offset[0];
+    command->offset[1] = offset[1];
+    command->size = size;
+    command->len = len;
+    command->has_col = col != NULL;
+
+    if (copy) {
+        size_t needed = len + 1 + (col ? len : 0);
+        if (f->text_size + needed > f->max_text) {
+            f->max_text = 2*(f->text_size + needed);
+            f->text = (char*)MV_EF_REALLOC(f->text, f->max_text);
+        }
+        command->str = command->col = NULL;
+        command->text = f->text_size;
+        memcpy(f->text + f->text_size, str, len + 1);
+        if (col)
+            memcpy(f->text + f->text_size + len + 1, col, len);
+        f->text_size += needed;
+    } else {
+        command->str = str;
+        command->col = col;
+    }
+
+    mv_ef_end_record(producer);
+}
+
+void mv_ef_queue_text(mv_ef_producer *producer, const char *str, const char *col, float offset[2], float size)
+{
+    mv_ef_record_text(producer, str, col, offset, size, 1);
+}
+
+void mv_ef_queue_text_ref(mv_ef_producer *producer, const char *str, const char *col, float offset[2], float size)
+{
+    mv_ef_record_text(producer, str, col, offset, size, 0);
+}
+
+// lays out one command into the instance buffer, starting a new run when the size changes
+static void mv_ef_queue_layout(mv_ef_queue *queue, const char *str, const char *col, const mv_ef_queue_command *command, int *num_instances)
+{
+    if (*num_instances + command->len > queue->max_instances) {
+        queue->max_instances = 2*(*num_instances + command->len);
+        queue->instances = (float*)MV_EF_REALLOC(queue->instances, 4*queue->max_instances*sizeof(float));
+    }
+
+    int first = *num_instances;
+    int count = mv_ef_layout_string(queue->ctx, str, col, command->offset[0], command->offset[1], command->size, 1, queue->instances + 4*first);
+    if (count == 0)
+        return;
+    *num_instances += count;
+
+    mv_ef_queue_run *last = queue->num_runs ? &queue->runs[queue->num_runs-1] : NULL;
+    if (last && last->size == command->size) {
+        last->count += count;
+        return;
+    }
+
+    if (queue->num_runs == queue->max_runs) {
+        queue->max_runs = queue->max_runs ? 2*queue->max_runs : 16;
+        queue->runs = (mv_ef_queue_run*)MV_EF_REALLOC(queue->runs, queue->max_runs*sizeof(mv_ef_queue_run));
+    }
+    mv_ef_queue_run *run = &queue->runs[queue->num_runs++];
+    run->first = first;
+    run->count = count;
+    run->size = command->size;
+}
+
+//
+// Render thread only. ends the current frame and draws everything recorded into it, 
+// in the order of the producers and then of the commands. returns the number of glyphs drawn
+//
+int mv_ef_queue_submit(mv_ef_queue *queue)
+{
+    mv_ef_context *ctx = queue->ctx;
+    mv_ef_font *font = &ctx->font;
+
+    long frame = mv_ef_atomic_add(&queue->frame, 1);
+    long num_producers = mv_ef_atomic_load(&queue->num_producers);
+    if (num_producers > MV_EF_MAX_PRODUCERS)
+        num_producers = MV_EF_MAX_PRODUCERS;
+
+    // the producers still copying a string into the frame that just ended
+    for (int i = 0; i < num_producers; i++)
+        while (mv_ef_atomic_load(&queue->producers[i].active) == frame + 1) {}
+
+    if (font->initialized == 0)
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+
+    // all the layout first, since new glyphs may be rasterized and uploaded to the atlas on the way
+    int ready = mv_ef_ctx_font_ready(ctx);
+    int num_instances = 0;
+    queue->num_runs = 0;
+    for (int i = 0; i < num_producers; i++) {
+        mv_ef_queue_frame *f = &queue->producers[i].frames[frame & 1];
+        for (int j = 0; ready && j < f->num_commands; j++) {
+            mv_ef_queue_command *command = &f->commands[j];
+            const char *str = command->str ? command->str : f->text + command->text;
+            const char *col = command->str ? command->col : f->text + command->text + command->len + 1;
+            mv_ef_queue_layout(queue, str, command->has_col ? col : NULL, command, &num_instances);
+        }
+        f->num_commands = 0;
+        f->text_size = 0;
+    }
+
+    if (num_instances == 0)
+        return 0;
+
+    mv_ef_gl_state last;
+    mv_ef_begin_draw(ctx, &last);
+
+    float no_offset[2] = {0.0, 0.0}; // already in the instances
+    glUniform2fv(glGetUniformLocation(font->program, "string_offset"), 1, no_offset);
+    GLint scale_factor = glGetUniformLocation(font->program, "scale_factor");
+
+    // uploaded in pieces the size of the instance vbo, MAX_STRING_LEN glyphs, which is normally all of them
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo_instances);
+    int uploaded_first = 0, uploaded_end = 0;
+    for (int r = 0; r < queue->num_runs; r++) {
+        mv_ef_queue_run *run = &queue->runs[r];
+        glUniform1f(scale_factor, run->size/font->font_size);
+
+        for (int first = run->first; first < run->first + run->count; ) {
+            if (first >= uploaded_end) {
+                uploaded_first = first;
+                uploaded_end = first + MAX_STRING_LEN < num_instances ? first + MAX_STRING_LEN : num_instances;
+                if (uploaded_first > 0) // orphaned, the previous piece may still be in use
+                    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, 4*4*(uploaded_end - uploaded_first), queue->instances + 4*uploaded_first);
+            }
+
+            int end = run->first + run->count < uploaded_end ? run->first + run->count : uploaded_end;
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float)*4*(first - uploaded_first)));
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, end - first);
+            first = end;
+        }
+    }
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    mv_ef_end_draw(&last);
+    return num_instances;
+}
+
+//
+// Log consoles
+//
+// The ring is a power of two of fixed size slots. a producer first reserves room by incrementing the count 
+// of lines in the ring, and backs off and drops the line if that goes over the size, then takes the next 
+// ticket, copies the line into the ticket's slot and publishes it by storing the ticket in the slot's sequence. 
+// that is a bounded number of steps whatever the other threads do. the reservation guarantees the slot's 
+// previous line was consumed. the render thread consumes tickets in order, and stops at the first one that 
+// isn't published yet, so a producer that is preempted while copying only delays the lines after its own.
+//
+// Consumed lines are laid out once, into a ring of glyph instances mirrored in a vbo, and only the new 
+// instances are uploaded. rows are stored as y = -(row % MV_EF_CONSOLE_ROW_PERIOD)*linedist, so the instances 
+// never change when the console scrolls, only the string_offset of the draw calls
+//
+#ifndef MV_EF_LOG_LINE_LEN
+#define MV_EF_LOG_LINE_LEN 256 // longer lines are cut
+#endif
+
+#ifndef MV_EF_LOG_MAX_SPANS
+#define MV_EF_LOG_MAX_SPANS 16
+#endif
+
+#ifndef MV_EF_CONSOLE_GLYPHS_PER_LINE
+#define MV_EF_CONSOLE_GLYPHS_PER_LINE 96 // average, sizes the instance ring
+#endif
+
+#define MV_EF_CONSOLE_ROW_PERIOD 4096
+
+typedef struct {
+    volatile long seq; // ticket+1 once the line of that ticket is in the slot
+    int num_spans;
+    mv_ef_color_span spans[MV_EF_LOG_MAX_SPANS];
+    char text[MV_EF_LOG_LINE_LEN];
+} mv_ef_log_slot;
+
+typedef struct {
+    int first, count; // in the instance ring
+    long row;
+} mv_ef_console_line;
+
+struct mv_ef_console {
+    mv_ef_context *ctx;
+    float font_size;
+
+    // the ring of log lines
+    mv_ef_log_slot *slots;
+    long ring_size;         // power of two
+    volatile long reserved; // lines in the ring, including the ones being written
+    volatile long tail;     // next ticket
+    long head;              // next ticket to consume, render thread only
+    volatile long dropped;
+
+    // the scrollback, render thread only
+    GLuint vao, vbo;
+    float *instances; // cpu side copy of the vbo
+    int max_instances;
+    int write;        // where the next line's instances go
+    int dirty_first, dirty_end;
+    mv_ef_console_line *lines;
+    int max_lines, first_line, num_lines;
+    long next_row;
+};
+
+mv_ef_console *mv_ef_create_console(mv_ef_context *ctx, float font_size, int max_lines, int ring_size)
+{
+    mv_ef_console *console = (mv_ef_console*)MV_EF_MALLOC(sizeof(mv_ef_console));
+    memset(console, 0, sizeof(*console));
+    console->ctx = ctx;
+    console->font_size = font_size;
+
+    console->ring_size = 1;
+    while (console->ring_size < ring_size)
+        console->ring_size *= 2;
+    console->slots = (mv_ef_log_slot*)MV_EF_MALLOC(console->ring_size*sizeof(mv_ef_log_slot));
+    memset(console->slots, 0, console->ring_size*sizeof(mv_ef_log_slot));
+
+    console->max_lines = max_lines > 0 ? max_lines : 1;
+    console->lines = (mv_ef_console_line*)MV_EF_MALLOC(console->max_lines*sizeof(mv_ef_console_line));
+    console->max_instances = console->max_lines*MV_EF_CONSOLE_GLYPHS_PER_LINE;
+    if (console->max_instances < MV_EF_LOG_LINE_LEN)
+        console->max_instances = MV_EF_LOG_LINE_LEN;
+    console->instances = (float*)MV_EF_MALLOC(4*console->max_instances*sizeof(float));
+    console->dirty_first = console->max_instances;
+    return console;
+}
+
+// the opengl context must be current, and no producer may be logging anymore
+void mv_ef_destroy_console(mv_ef_console *console)
+{
+    if (!console)
+        return;
+
+    glDeleteVertexArrays(1, &console->vao);
+    glDeleteBuffers(1, &console->vbo);
+    MV_EF_FREE(console->slots);
+    MV_EF_FREE(console->lines);
+    MV_EF_FREE(console->instances);
+    MV_EF_FREE(console);
+}
+
+//
+// Appends a line, from any thread. spans give the colors, in order of start, and the bytes before 
+// the first span have color 0. returns 0 if the line was dropped because the ring is full
+//
+int mv_ef_log_spans(mv_ef_console *console, const char *line, const mv_ef_color_span *spans, int num_spans)
+{
+    if (mv_ef_atomic_add(&console->reserved, 1) >= console->ring_size) {
+        mv_ef_atomic_add(&console->reserved, -1);
+        mv_ef_atomic_add(&console->dropped, 1);
+        return 0;
+    }
+
+    long ticket = mv_ef_atomic_add(&console->tail, 1);
+    mv_ef_log_slot *slot = &console->slots[(unsigned long)ticket & (console->ring_size-1)];
+
+    // one row per line, so newlines become spaces
+    int len = 0;
+    for (; line[len] && len < MV_EF_LOG_LINE_LEN-1; len++)
+        slot->text[len] = line[len] == '\n' ? ' ' : line[len];
+    slot->text[len] = '\0';
+
+    slot->num_spans = num_spans < MV_EF_LOG_MAX_SPANS ? num_spans : MV_EF_LOG_MAX_SPANS;
+    memcpy(slot->spans, spans, slot->num_spans*sizeof(mv_ef_color_span));
+
+    mv_ef_atomic_store(&slot->seq, ticket + 1);
+    return 1;
+}
+
+int mv_ef_log(mv_ef_console *console, const char *line, int color)
+{
+    mv_ef_color_span span = {0, color};
+    return mv_ef_log_spans(console, line, &span, 1);
+}
+
+long mv_ef_console_dropped(mv_ef_console *console)
+{
+    return mv_ef_atomic_load(&console->dropped);
+}
+
+// lays out a consumed line at the end of the scrollback, pushing out the lines it overwrites
+static void mv_ef_console_append(mv_ef_console *console, const mv_ef_log_slot *slot)
+{
+    mv_ef_font *font = &console->ctx->font;
+
+    char col[MV_EF_LOG_LINE_LEN];
+    int len = strlen(slot->text);
+    memset(col, 0, len);
+    for (int i = 0; i < slot->num_spans; i++) {
+        int start = slot->spans[i].start < 0 ? 0 : slot->spans[i].start;
+        int end = i+1 < slot->num_spans ? slot->spans[i+1].start : len;
+        for (int j = start; j < end && j < len; j++)
+            col[j] = slot->spans[i].color;
+    }
+
+    // a line never wraps around the end of the instance ring. the lines between where it wraps and the end are then passed over
+    int wrapped_from = -1;
+    if (console->write + len > console->max_instances) {
+        wrapped_from = console->write;
+        console->write = 0;
+    }
+
+    long row = console->next_row++;
+    float y = -(float)(row & (MV_EF_CONSOLE_ROW_PERIOD-1))*font->linedist*console->font_size/font->font_size;
+    int first = console->write;
+    int count = mv_ef_layout_string(console->ctx, slot->text, col, 0.0, y, console->font_size, 1, console->instances + 4*first);
+
+    // the lines whose instances are overwritten, or that were passed over by a wrap, are the oldest ones, 
+    // give or take empty lines in between, which have no instances to overwrite. those are pushed out 
+    // along with the lines after them, so an empty line doesn't hold on to overwritten ones
+    int num_evicted = console->num_lines == console->max_lines ? 1 : 0;
+    for (int i = 0; i < console->num_lines; i++) {
+        mv_ef_console_line *l = &console->lines[(console->first_line + i) % console->max_lines];
+        if (l->count == 0)
+            continue;
+        int overlaps = l->first < first + count && l->first + l->count > first;
+        int passed_over = wrapped_from >= 0 && l->first >= wrapped_from;
+        if (!overlaps && !passed_over)
+            break;
+        num_evicted = i + 1;
+    }
+    console->first_line = (console->first_line + num_evicted) % console->max_lines;
+    console->num_lines -= num_evicted;
+
+    mv_ef_console_line *l = &console->lines[(console->first_line + console->num_lines) % console->max_lines];
+    l->first = first;
+    l->count = count;
+    l->row = row;
+    console->num_lines++;
+
+    if (first < console->dirty_first)
+        console->dirty_first = first;
+    if (first + count > console->dirty_end)
+        console->dirty_end = first + count;
+    console->write = first + count;
+}
+
+//
+// Render thread only. lays out the lines logged since the last update and uploads their glyphs.
+// returns the number of new lines. lines stay in the ring until the font is ready
+//
+int mv_ef_console_update(mv_ef_console *console)
 {
-    font.initialized = 1;
+    mv_ef_context *ctx = console->ctx;
+    mv_ef_font *font = &ctx->font;
 
-    font.program = mv_ef_load_shaders(vs_filename, fs_filename);
+    if (font->initialized == 0)
+        mv_ef_ctx_init(ctx, NULL, 48.0, NULL, NULL);
+    if (!mv_ef_ctx_font_ready(ctx))
+        return 0;
 
-    // load .ttf into a bitmap using stb_truetype.h
-    font.width = 512;
-    font.height = 512;
-    font.font_size = font_size;
+    if (!console->vao) {
+        glGenVertexArrays(1, &console->vao);
+        glBindVertexArray(console->vao);
 
-    // Read the data from file
-    int ttf_size_max = 1e6;
-    unsigned char *ttf_buffer = (unsigned char*)malloc(ttf_size_max); // sufficient size for consola.ttf
+        glBindBuffer(GL_ARRAY_BUFFER, font->vbo_quad);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,(void*)0);
+        glVertexAttribDivisor(0, 0);
 
-    const char *ttf_filenames[] = {
-        "extra/Inconsolata-Regular.ttf",
-        "Inconsolata-Regular.ttf",
-        "C:/Windows/Fonts/consola.ttf",
-        "/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
-    };
+        glGenBuffers(1, &console->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, console->vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*console->max_instances, NULL, GL_DYNAMIC_DRAW);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1,4,GL_FLOAT,GL_FALSE,0,(void*)0);
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+    }
 
+    int consumed = 0;
+    for (int wrapped = 1; wrapped; ) {
+        wrapped = 0;
+        for (;;) {
+            mv_ef_log_slot *slot = &console->slots[(unsigned long)console->head & (console->ring_size-1)];
+            if (mv_ef_atomic_load(&slot->seq) != console->head + 1)
+                break;
 
-    FILE *fp;
-    if ((fp = fopen(filename, "rb"))) {
-        strcpy(font.filename, filename);
-    } else {
-        int found = 0;
-        for (int i = 0; i < 4; i++) {
-            if ((fp = fopen(ttf_filenames[i], "rb"))) {
-                strcpy(font.filename, ttf_filenames[i]);
-                found = 1;
+            // uploads what's dirty before wrapping around, so the dirty range stays one piece
+            if (console->write + (int)strlen(slot->text) > console->max_instances && console->dirty_end > console->dirty_first) {
+                wrapped = 1;
                 break;
             }
+
+            mv_ef_console_append(console, slot);
+            console->head++;
+            mv_ef_atomic_add(&console->reserved, -1);
+            consumed++;
         }
 
-        if (!found) {
-            printf("I give up. Can't find a valid .ttf file. Exiting.\n");
-            exit(-9);
+        if (console->dirty_end > console->dirty_first) {
+            glBindBuffer(GL_ARRAY_BUFFER, console->vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(float)*4*console->dirty_first, sizeof(float)*4*(console->dirty_end - console->dirty_first), 
+                            console->instances + 4*console->dirty_first);
+            console->dirty_first = console->max_instances;
+            console->dirty_end = 0;
         }
     }
 
-    printf("Using font file: \"%s\"\n", font.filename);
+    return consumed;
+}
 
-    fread(ttf_buffer, 1, ttf_size_max, fp);
-    fclose(fp);
-    
-    // Pack and create bitmap
-    unsigned char *bitmap = (unsigned char*)malloc(font.height*font.width);
-    stbtt_pack_context pc;
-    stbtt_PackBegin(&pc, bitmap, font.width, font.height, 0, 1, NULL);   
-    stbtt_PackSetOversampling(&pc, 1, 1);
-    stbtt_PackFontRange(&pc, ttf_buffer, 0, font.font_size, 32, 96, font.cdata);
-    stbtt_PackEnd(&pc);
+//
+// Render thread only. draws num_rows lines with the top one at offset, ending scroll lines above the newest.
+// one draw call per stretch of lines that are contiguous in the instance ring
+//
+void mv_ef_console_draw(mv_ef_console *console, float offset[2], int num_rows, int scroll)
+{
+    mv_ef_context *ctx = console->ctx;
+    mv_ef_font *font = &ctx->font;
+    if (!console->vao || console->num_lines == 0)
+        return;
+
+    if (scroll > console->num_lines - num_rows)
+        scroll = console->num_lines - num_rows;
+    if (scroll < 0)
+        scroll = 0;
+    int last = console->num_lines - scroll; // one past the last line drawn
+    int first = last - num_rows > 0 ? last - num_rows : 0;
+
+    mv_ef_gl_state state;
+    mv_ef_begin_draw(ctx, &state);
+    glBindVertexArray(console->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, console->vbo);
+    glUniform1f(glGetUniformLocation(font->program, "scale_factor"), console->font_size/font->font_size);
+    GLint string_offset = glGetUniformLocation(font->program, "string_offset");
+
+    float l = font->linedist*console->font_size/font->font_size;
+    long top_row = console->lines[(console->first_line + first) % console->max_lines].row;
+    for (int i = first; i < last; ) {
+        mv_ef_console_line *start = &console->lines[(console->first_line + i) % console->max_lines];
+        int begin = start->first, end = start->first + start->count;
+        long period = start->row / MV_EF_CONSOLE_ROW_PERIOD;
+
+        for (i++; i < last; i++) {
+            mv_ef_console_line *next = &console->lines[(console->first_line + i) % console->max_lines];
+            if (next->first != end || next->row / MV_EF_CONSOLE_ROW_PERIOD != period)
+                break;
+            end += next->count;
+        }
+
+        // moves the stored row of the first line of the stretch to its row on screen
+        long stored_row = start->row & (MV_EF_CONSOLE_ROW_PERIOD-1);
+        float stretch_offset[2] = {offset[0], offset[1] + (stored_row - (start->row - top_row))*l};
+        glUniform2fv(string_offset, 1, stretch_offset);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(float)*4*begin));
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, end - begin);
+    }
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    mv_ef_end_draw(&state);
+}
 
-#ifdef STB_IMAGE_WRITE_IMPLEMENTATION
-    stbi_write_png("font.png", font.width, font.height, 1, bitmap, 0);
+//
+// Software rendering
+//
+// Every glyph instance becomes the same quad the vertex shader makes of it, in pixels with y pointing down,
+// and the pixels whose centers are inside it sample the atlas bilinearly at the interpolated uv, like 
+// GL_LINEAR with clamping to the edge. RGBA framebuffers are blended like glBlendFunc(GL_SRC_ALPHA, 
+// GL_ONE_MINUS_SRC_ALPHA), alpha channel included, and A8 framebuffers get the coverage blended over what's there. 
+// with mip levels the gpu samples smaller levels for minified text, while this always samples the full size atlas.
+//
+// The framebuffer is cut into MV_EF_TILE_SIZE tiles, the glyphs are binned by the tiles they touch, in order,
+// and threads take whole tiles, so no two threads ever write the same pixel and the result doesn't depend 
+// on the number of threads
+//
+#ifndef MV_EF_TILE_SIZE
+#define MV_EF_TILE_SIZE 64
 #endif
 
-    // calculate vertical font metrics
-    stbtt_fontinfo info;
-    stbtt_InitFont(&info, ttf_buffer, stbtt_GetFontOffsetForIndex(ttf_buffer,0));
+// a glyph instance as a quad on the framebuffer, mapped to texels of an atlas page
+typedef struct {
+    float x0, y0, x1, y1;    // quad, in pixels
+    float s0, t0, ds, dt;    // texel coordinates of the first pixel center, and their step per pixel
+    int px0, py0, px1, py1;  // pixels whose centers are inside, clipped to the framebuffer
+    const unsigned char *page;
+    float color[4];          // rgb in [0, 255]
+} mv_ef_cpu_glyph;
 
-    float s = stbtt_ScaleForPixelHeight(&info, font.font_size);
-    int a, d, l;
-    stbtt_GetFontVMetrics(&info, &a, &d, &l);
-    
-    font.ascent = a*s;
-    font.descent = d*s;
-    font.linegap = l*s;
-    font.linedist = font.ascent - font.descent + font.linegap;
+typedef struct {
+    const mv_ef_cpu_glyph *glyphs;
+    const int *bin_start;  // glyphs of tile i are bins[bin_start[i]] to bins[bin_start[i+1]]
+    const int *bins;
+    int tiles_x, num_tiles;
+    int page_width, page_height;
+    mv_ef_framebuffer *fb;
+    volatile long next_tile;
+} mv_ef_cpu_job;
 
-    free(ttf_buffer);
+// one row of a glyph, clipped to [x0, x1)
+static void mv_ef_cpu_glyph_row(const mv_ef_cpu_job *job, const mv_ef_cpu_glyph *g, int py, int x0, int x1)
+{
+    int w = job->page_width, h = job->page_height;
 
-    // output char metrics per char
-    int max_y1 = 0; // for truncating packed texture if nescessary
-    for (int i = 0; i < 96; i++) {
-        /*
-        printf("%3d %2c: (%3u, %3u, %3u, %3u), %+6.2f, %+6.2f, %+6.2f, %+6.2f, %f\n", i, i+32, 
-                                                                                      font.cdata[i].x0,    font.cdata[i].y0, 
-                                                                                      font.cdata[i].x1,    font.cdata[i].y1,
-                                                                                      font.cdata[i].xoff,  font.cdata[i].yoff, 
-                                                                                      font.cdata[i].xoff2, font.cdata[i].yoff2,
-                                                                                      font.cdata[i].xadvance);
-        */
-        if (font.cdata[i].y1 > max_y1)
-            max_y1 = font.cdata[i].y1;
+    // bilinear weights and rows, clamped to the edge like the texture
+    float t = g->t0 + (py - g->py0)*g->dt;
+    int iy = (int)floorf(t);
+    float fy = t - iy;
+    int ya = iy < 0 ? 0 : iy >= h ? h-1 : iy;
+    int yb = iy+1 < 0 ? 0 : iy+1 >= h ? h-1 : iy+1;
+    const unsigned char *row_a = g->page + (size_t)ya*w;
+    const unsigned char *row_b = g->page + (size_t)yb*w;
+
+    float alpha[MV_EF_TILE_SIZE];
+    for (int px = x0; px < x1; px++) {
+        float s = g->s0 + (px - g->px0)*g->ds;
+        int ix = (int)floorf(s);
+        float fx = s - ix;
+        int xa = ix < 0 ? 0 : ix >= w ? w-1 : ix;
+        int xb = ix+1 < 0 ? 0 : ix+1 >= w ? w-1 : ix+1;
+        float top    = row_a[xa] + fx*(row_a[xb] - row_a[xa]);
+        float bottom = row_b[xa] + fx*(row_b[xb] - row_b[xa]);
+        alpha[px - x0] = (top + fy*(bottom - top))*(1.0f/255.0f);
     }
 
-    // cut away the unused part of the bitmap
-    font.height = max_y1+1;
+    mv_ef_framebuffer *fb = job->fb;
+    unsigned char *dst = fb->pixels + (size_t)py*fb->stride + (size_t)x0*fb->channels;
+    int n = x1 - x0;
+    if (fb->channels == 4) {
+#ifdef MV_EF_SSE2
+        __m128 color = _mm_setr_ps(g->color[0], g->color[1], g->color[2], 0.0f);
+        __m128i zero = _mm_setzero_si128();
+        for (int i = 0; i < n; i++, dst += 4) {
+            float a = alpha[i];
+            if (a <= 0.0f)
+                continue;
 
-    // vaos
-    glGenVertexArrays(1, &font.vao);
-    glBindVertexArray(font.vao);
+            // src*a + dst*(1-a), with the alpha channel's src being a as well
+            __m128 av = _mm_set1_ps(a);
+            __m128 src = _mm_add_ps(_mm_mul_ps(color, av), _mm_setr_ps(0.0f, 0.0f, 0.0f, 255.0f*a*a));
+            __m128i d = _mm_cvtsi32_si128(*(const int*)dst);
+            __m128 df = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(d, zero), zero));
+            __m128 out = _mm_add_ps(src, _mm_mul_ps(df, _mm_sub_ps(_mm_set1_ps(1.0f), av)));
+            __m128i o = _mm_cvttps_epi32(_mm_add_ps(out, _mm_set1_ps(0.5f))); // rounded like the scalar version, which may still differ by a level
+            o = _mm_packus_epi16(_mm_packs_epi32(o, zero), zero);
+            *(int*)dst = _mm_cvtsi128_si32(o);
+        }
+#else
+        for (int i = 0; i < n; i++, dst += 4) {
+            float a = alpha[i];
+            if (a <= 0.0f)
+                continue;
+            for (int c = 0; c < 3; c++)
+                dst[c] = (unsigned char)(g->color[c]*a + dst[c]*(1.0f - a) + 0.5f);
+            dst[3] = (unsigned char)(255.0f*a*a + dst[3]*(1.0f - a) + 0.5f);
+        }
+#endif
+    } else {
+        int i = 0;
+#ifdef MV_EF_SSE2
+        // 4 pixels at a time, coverage over coverage
+        __m128i zero = _mm_setzero_si128();
+        __m128 one = _mm_set1_ps(1.0f), full = _mm_set1_ps(255.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 av = _mm_loadu_ps(alpha + i);
+            __m128i d = _mm_cvtsi32_si128(*(const int*)(dst + i));
+            __m128 df = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(d, zero), zero));
+            __m128 out = _mm_add_ps(_mm_mul_ps(full, av), _mm_mul_ps(df, _mm_sub_ps(one, av)));
+            __m128i o = _mm_cvttps_epi32(_mm_add_ps(out, _mm_set1_ps(0.5f)));
+            o = _mm_packus_epi16(_mm_packs_epi32(o, zero), zero);
+            *(int*)(dst + i) = _mm_cvtsi128_si32(o);
+        }
+#endif
+        for (; i < n; i++)
+            dst[i] = (unsigned char)(255.0f*alpha[i] + dst[i]*(1.0f - alpha[i]) + 0.5f);
+    }
+}
 
-    // quad vbo setup, used for glyph vertex positions, 
-    // just uv coordinates that will be stretched accordingly by the glyphs width and height
-    float v[] = {0.0, 0.0, 
-                 1.0, 0.0, 
-                 0.0, 1.0,
-                 0.0, 1.0,
-                 1.0, 0.0,
-                 1.0, 1.0};
+static void mv_ef_cpu_render_tile(mv_ef_cpu_job *job, int tile)
+{
+    int tx0 = (tile % job->tiles_x)*MV_EF_TILE_SIZE;
+    int ty0 = (tile / job->tiles_x)*MV_EF_TILE_SIZE;
+    int tx1 = tx0 + MV_EF_TILE_SIZE < job->fb->width  ? tx0 + MV_EF_TILE_SIZE : job->fb->width;
+    int ty1 = ty0 + MV_EF_TILE_SIZE < job->fb->height ? ty0 + MV_EF_TILE_SIZE : job->fb->height;
 
-    glGenBuffers(1, &font.vbo_quad);
-    glBindBuffer(GL_ARRAY_BUFFER, font.vbo_quad);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(v), v, GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,2,GL_FLOAT,GL_FALSE,0,(void*)0);
-    glVertexAttribDivisor(0, 0);
+    for (int i = job->bin_start[tile]; i < job->bin_start[tile+1]; i++) {
+        const mv_ef_cpu_glyph *g = &job->glyphs[job->bins[i]];
+        int x0 = g->px0 > tx0 ? g->px0 : tx0, x1 = g->px1 < tx1 ? g->px1 : tx1;
+        int y0 = g->py0 > ty0 ? g->py0 : ty0, y1 = g->py1 < ty1 ? g->py1 : ty1;
+        for (int py = y0; py < y1; py++)
+            mv_ef_cpu_glyph_row(job, g, py, x0, x1);
+    }
+}
 
-    // instance vbo setup.
-    // for glyph positions, glyph index and color index
-    glGenBuffers(1, &font.vbo_instances);
-    glBindBuffer(GL_ARRAY_BUFFER, font.vbo_instances);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*4*MAX_STRING_LEN, NULL, GL_DYNAMIC_DRAW);
+static void mv_ef_cpu_render_tiles(mv_ef_cpu_job *job)
+{
+    for (;;) {
+        long tile = mv_ef_atomic_add(&job->next_tile, 1);
+        if (tile >= job->num_tiles)
+            break;
+        mv_ef_cpu_render_tile(job, (int)tile);
+    }
+}
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,4,GL_FLOAT,GL_FALSE,0,(void*)0);
-    glVertexAttribDivisor(1, 1);
-    //glEnable(GL_FRAMEBUFFER_SRGB); 
-    // setup and upload font bitmap texture
-    glGenTextures(1, &font.texture_fontdata);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, font.texture_fontdata);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, font.width, font.height, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#ifndef MV_EF_NO_THREADS
+static MV_EF_THREAD_PROC(mv_ef_cpu_thread)
+{
+    mv_ef_cpu_render_tiles((mv_ef_cpu_job*)arg);
+    return 0;
+}
+#endif
+
+// mv_ef_ctx_render_instances() with the rgb triplets of palette in place of the context's colors
+static void mv_ef_render_palette(mv_ef_context *ctx, mv_ef_framebuffer *fb, const float *instances, int count, float offset[2], float size, const unsigned char *palette, int num_threads)
+{
+    mv_ef_font *font = &ctx->font;
+    if (!font->ready || count <= 0 || fb->width <= 0 || fb->height <= 0)
+        return;
 
-    free(bitmap);
+    float k = size/font->font_size;
+    float first_line = font->linedist - font->linegap; // offset_firstline of the vertex shader
 
-    // setup and upload font metadata texture
-    // used for lookup in the bitmap texture    
-    glGenTextures(1, &font.texture_metadata);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, font.texture_metadata);
+    int tiles_x = (fb->width  + MV_EF_TILE_SIZE-1)/MV_EF_TILE_SIZE;
+    int tiles_y = (fb->height + MV_EF_TILE_SIZE-1)/MV_EF_TILE_SIZE;
+    int num_tiles = tiles_x*tiles_y;
 
-    float *texture_metadata = (float*)malloc(sizeof(float)*8*NUM_GLYPHS);
-    
-    for (int i = 0; i < NUM_GLYPHS; i++) {
-        int k1 = 0*NUM_GLYPHS + i;
-        int k2 = 1*NUM_GLYPHS + i;
-        texture_metadata[4*k1+0] = font.cdata[i].x0/(double)font.width;
-        texture_metadata[4*k1+1] = font.cdata[i].y0/(double)font.height;
-        texture_metadata[4*k1+2] = (font.cdata[i].x1-font.cdata[i].x0)/(double)font.width;
-        texture_metadata[4*k1+3] = (font.cdata[i].y1-font.cdata[i].y0)/(double)font.height;
+    mv_ef_cpu_glyph *glyphs = (mv_ef_cpu_glyph*)MV_EF_MALLOC(count*sizeof(mv_ef_cpu_glyph));
+    int *bin_start = (int*)MV_EF_MALLOC((num_tiles+1)*sizeof(int));
+    memset(bin_start, 0, (num_tiles+1)*sizeof(int));
+
+    // the quads, and how many glyphs each tile gets
+    int num_glyphs = 0, num_binned = 0;
+    for (int i = 0; i < count; i++) {
+        const float *instance = instances + 4*i;
+        int slot = (int)instance[2];
+        if (slot < 0 || slot >= font->num_glyphs)
+            continue;
+        stbtt_packedchar *c = &font->cdata[slot];
+        if (c->x1 <= c->x0 || c->y1 <= c->y0)
+            continue;
+
+        mv_ef_cpu_glyph *g = &glyphs[num_glyphs];
+        g->x0 = k*c->xoff + instance[0] + offset[0];
+        g->x1 = k*c->xoff2 + instance[0] + offset[0];
+        g->y0 = k*(c->yoff + first_line) - instance[1] - offset[1];
+        g->y1 = k*(c->yoff2 + first_line) - instance[1] - offset[1];
+
+        g->px0 = (int)ceilf(g->x0 - 0.5f); g->px1 = (int)ceilf(g->x1 - 0.5f);
+        g->py0 = (int)ceilf(g->y0 - 0.5f); g->py1 = (int)ceilf(g->y1 - 0.5f);
+        g->ds = (c->x1 - c->x0)/(g->x1 - g->x0);
+        g->dt = (c->y1 - c->y0)/(g->y1 - g->y0);
+        g->s0 = c->x0 + (g->px0 + 0.5f - g->x0)*g->ds - 0.5f;
+        g->t0 = c->y0 + (g->py0 + 0.5f - g->y0)*g->dt - 0.5f;
+
+        // clipping keeps s0 and t0 at the unclipped first pixel, the rows and columns are offset from it
+        if (g->px0 < 0) g->px0 = 0;
+        if (g->py0 < 0) g->py0 = 0;
+        if (g->px1 > fb->width)  g->px1 = fb->width;
+        if (g->py1 > fb->height) g->py1 = fb->height;
+        if (g->px0 >= g->px1 || g->py0 >= g->py1)
+            continue;
+        g->s0 += (g->px0 - (int)ceilf(g->x0 - 0.5f))*g->ds;
+        g->t0 += (g->py0 - (int)ceilf(g->y0 - 0.5f))*g->dt;
+
+        g->page = font->bitmap + (size_t)font->glyph_layer[slot]*font->width*font->height;
+        int color = ((int)instance[3] % mv_ef_num_colors + mv_ef_num_colors) % mv_ef_num_colors;
+        for (int j = 0; j < 3; j++)
+            g->color[j] = palette[3*color + j];
+        g->color[3] = 255.0f;
 
-        texture_metadata[4*k2+0] = font.cdata[i].xoff/(double)font.width;
-        texture_metadata[4*k2+1] = font.cdata[i].yoff/(double)font.height;
-        texture_metadata[4*k2+2] = font.cdata[i].xoff2/(double)font.width;
-        texture_metadata[4*k2+3] = font.cdata[i].yoff2/(double)font.height;
+        for (int ty = g->py0/MV_EF_TILE_SIZE; ty <= (g->py1-1)/MV_EF_TILE_SIZE; ty++)
+            for (int tx = g->px0/MV_EF_TILE_SIZE; tx <= (g->px1-1)/MV_EF_TILE_SIZE; tx++)
+                bin_start[ty*tiles_x + tx + 1]++;
+        num_glyphs++;
     }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, NUM_GLYPHS, 2, 0, GL_RGBA, GL_FLOAT, texture_metadata);
+    for (int i = 0; i < num_tiles; i++)
+        bin_start[i+1] += bin_start[i];
+    num_binned = bin_start[num_tiles];
 
-    free(texture_metadata);
+    // the glyphs of every tile, in instance order
+    int *bins = (int*)MV_EF_MALLOC((num_binned > 0 ? num_binned : 1)*sizeof(int));
+    int *fill = (int*)MV_EF_MALLOC(num_tiles*sizeof(int));
+    memcpy(fill, bin_start, num_tiles*sizeof(int));
+    for (int i = 0; i < num_glyphs; i++) {
+        const mv_ef_cpu_glyph *g = &glyphs[i];
+        for (int ty = g->py0/MV_EF_TILE_SIZE; ty <= (g->py1-1)/MV_EF_TILE_SIZE; ty++)
+            for (int tx = g->px0/MV_EF_TILE_SIZE; tx <= (g->px1-1)/MV_EF_TILE_SIZE; tx++)
+                bins[fill[ty*tiles_x + tx]++] = i;
+    }
+    MV_EF_FREE(fill);
 
-    // setup color texture
-    //glUniform3fv(glGetUniformLocation(font.program, "colors"), 9, mv_ef_colors);
+    mv_ef_cpu_job job;
+    job.glyphs = glyphs;
+    job.bin_start = bin_start;
+    job.bins = bins;
+    job.tiles_x = tiles_x;
+    job.num_tiles = num_tiles;
+    job.page_width = font->width;
+    job.page_height = font->height;
+    job.fb = fb;
+    job.next_tile = 0;
 
-    glGenTextures(1, &font.texture_colors);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_1D, font.texture_colors);
-    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB, mv_ef_num_colors, 0, GL_RGB, GL_UNSIGNED_BYTE, mv_ef_colors);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+#ifndef MV_EF_NO_THREADS
+    if (num_threads <= 0)
+        num_threads = mv_ef_num_cpus();
+    if (num_threads > MV_EF_MAX_THREADS) num_threads = MV_EF_MAX_THREADS;
+    if (num_threads > num_tiles) num_threads = num_tiles;
+    if (num_binned < 256) num_threads = 1; // not worth a thread
 
-    // upload constant uniforms
-    glUseProgram(font.program);
-    glUniform1i(glGetUniformLocation(font.program, "sampler_font"), 0);
-    glUniform1i(glGetUniformLocation(font.program, "sampler_meta"), 1);
-    glUniform1i(glGetUniformLocation(font.program, "sampler_colors"), 2);
+    mv_ef_thread threads[MV_EF_MAX_THREADS];
+    int started[MV_EF_MAX_THREADS] = {0};
+    for (int i = 1; i < num_threads; i++)
+        started[i] = mv_ef_thread_create(&threads[i], mv_ef_cpu_thread, &job);
+    mv_ef_cpu_render_tiles(&job);
+    for (int i = 1; i < num_threads; i++)
+        if (started[i])
+            mv_ef_thread_join(threads[i]);
+#else
+    (void)num_threads;
+    mv_ef_cpu_render_tiles(&job);
+#endif
 
-    glUniform2f(glGetUniformLocation(font.program, "res_bitmap"), font.width, font.height);
-    glUniform2f(glGetUniformLocation(font.program, "res_meta"),  NUM_GLYPHS, 2);
-    glUniform1f(glGetUniformLocation(font.program, "num_colors"),  mv_ef_num_colors);
-    glUniform1f(glGetUniformLocation(font.program, "offset_firstline"), font.linedist-font.linegap);
+    MV_EF_FREE(bins);
+    MV_EF_FREE(bin_start);
+    MV_EF_FREE(glyphs);
 }
 
-// 
-// draw a string
-// 
-// will call mv_ef_init() if it's the first time it's called. 
-// can optionally call this manually
 //
-// will parse the string and update the instance vbo, then upload it
+// Draws count glyph instances (x, y, slot, color), as laid out for mv_ef_draw(), into fb.
+// num_threads <= 0 uses every core, up to MV_EF_MAX_THREADS. 
+// only reads the context, so several threads can render with the same one as long as nothing adds glyphs meanwhile
 //
-// finally draws
-// 
-void mv_ef_draw(char *str, char *col, float offset[2], float size) 
+void mv_ef_ctx_render_instances(mv_ef_context *ctx, mv_ef_framebuffer *fb, const float *instances, int count, float offset[2], float size, int num_threads)
 {
-    static float text_glyph_data[4*MAX_STRING_LEN] = {0};
-
-    if (font.initialized == 0) {
-        mv_ef_init(NULL, 48.0, NULL, NULL);
-    }
+    mv_ef_render_palette(ctx, fb, instances, count, offset, size, ctx->colors, num_threads);
+}
 
-    int len = strlen(str);
+//
+// Loads a font for software rendering only. no opengl context is needed, and no opengl function is called 
+// with this context, also not by mv_ef_glyph_slot(), mv_ef_add_atlas_page() or mv_ef_destroy_context()
+//
+int mv_ef_ctx_init_headless(mv_ef_context *ctx, char *filename, int face_index, int font_size)
+{
+    mv_ef_font *font = &ctx->font;
+    mv_ef_release_font(ctx);
+    font->initialized = 1;
+    ctx->headless = 1;
 
-    if (len > MAX_STRING_LEN) {
-        printf("Error: string too long. Returning\n");
-        return;
-    } 
+    mv_ef_arena_begin(&ctx->arena);
+    int loaded = mv_ef_load_font(ctx, filename, face_index, font_size);
+    font->init_arena_used = mv_ef_arena_end(&ctx->arena);
 
-    // parse string, convert to vbo data
-    float X = 0.0;
-    float Y = 0.0;
-    float l = font.linedist*size/font.font_size;
+    // the atlas is only on the cpu
+    font->ready = loaded;
+    return loaded;
+}
 
-    float advances[96];
-    for (int i = 0; i < 96; i++)
-        advances[i] = font.cdata[i].xadvance*size/font.font_size;
+void mv_ef_ctx_draw_cpu(mv_ef_context *ctx, mv_ef_framebuffer *fb, char *str, char *col, float offset[2], float size)
+{
+    if (!mv_ef_ctx_font_ready(ctx))
+        return;
 
-    float *t = text_glyph_data;
-    for (char *c = str; *c; c++) {
+    float *instances = (float*)MV_EF_MALLOC(4*(strlen(str) + 1)*sizeof(float));
+    int count = mv_ef_layout_string(ctx, str, col, 0.0, 0.0, size, 1, instances);
+    mv_ef_ctx_render_instances(ctx, fb, instances, count, offset, size, 0);
+    MV_EF_FREE(instances);
+}
 
-        if ((*c) == '\n') {
-            X = 0.0;
-            Y -= l;
-            continue;
-        }
+int mv_ef_init_headless(char *filename, int font_size)
+{
+    return mv_ef_ctx_init_headless(mv_ef_default_context(), filename, 0, font_size);
+}
 
-        int code_base = (*c)-32; // first glyph is ' ', i.e. ascii code 32
-        float dx = advances[code_base];
+void mv_ef_draw_cpu(mv_ef_framebuffer *fb, char *str, char *col, float offset[2], float size)
+{
+    mv_ef_ctx_draw_cpu(mv_ef_default_context(), fb, str, col, offset, size);
+}
 
-        *t++ = X;
-        *t++ = Y;
-        *t++ = code_base;
-        *t++ = col ? col[c-str] : 0;
+//
+// Batch image rendering
+//
+// A pool of workers takes jobs off a shared counter. every worker has its own scratch framebuffer and 
+// instance buffer, grown to the largest job it has seen, so the steady state allocates nothing per image 
+// but the binning of mv_ef_render_palette(). the context is shared and only read: every character of every 
+// job is given its glyph up front, on the calling thread, and the workers then only look glyphs up
+//
+typedef struct {
+    mv_ef_context *ctx;
+    const mv_ef_image_job *jobs;
+    int num_jobs;
+    mv_ef_image_done done;
+    void *userdata;
+    volatile long next_job;
+} mv_ef_batch;
 
-        X += dx;
-    }
-    int ctr = (t - text_glyph_data)/4;
+static void mv_ef_batch_work(mv_ef_batch *batch)
+{
+    mv_ef_framebuffer fb;
+    fb.pixels = NULL;
+    fb.channels = 4;
+    size_t pixels_size = 0;
 
-    // Backup GL state
-    GLint last_program, last_vertex_array; 
-    GLint last_texture0, last_texture1, last_texture2; 
-    GLint last_blend_src, last_blend_dst; 
-    GLint last_blend_equation_rgb, last_blend_equation_alpha; 
+    float *instances = NULL;
+    size_t num_instances = 0;
 
-    glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+    for (;;) {
+        long index = mv_ef_atomic_add(&batch->next_job, 1);
+        if (index >= batch->num_jobs)
+            break;
 
-    glActiveTexture(GL_TEXTURE0); 
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture0);
-    glActiveTexture(GL_TEXTURE1); 
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture1);
-    glActiveTexture(GL_TEXTURE2); 
-    glGetIntegerv(GL_TEXTURE_BINDING_1D, &last_texture2);
+        const mv_ef_image_job *job = &batch->jobs[index];
+        if (job->width <= 0 || job->height <= 0)
+            continue;
 
-    glGetIntegerv(GL_BLEND_SRC, &last_blend_src);
-    glGetIntegerv(GL_BLEND_DST, &last_blend_dst);
-    glGetIntegerv(GL_BLEND_EQUATION_RGB,   &last_blend_equation_rgb);
-    glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &last_blend_equation_alpha);
+        size_t size = (size_t)job->width*job->height*4;
+        if (size > pixels_size) {
+            MV_EF_FREE(fb.pixels);
+            fb.pixels = (unsigned char*)MV_EF_MALLOC(size);
+            pixels_size = size;
+        }
+        fb.width = job->width;
+        fb.height = job->height;
+        fb.stride = 4*job->width;
 
-    GLboolean last_enable_blend      = glIsEnabled(GL_BLEND);
-    GLboolean last_enable_depth_test = glIsEnabled(GL_DEPTH_TEST);
+        unsigned int *p = (unsigned int*)fb.pixels;
+        unsigned int background;
+        memcpy(&background, job->background, 4);
+        for (size_t i = 0; i < size/4; i++)
+            p[i] = background;
 
-    // Setup render state: alpha-blending enabled, no depth testing and bind textures
-    glEnable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        size_t length = strlen(job->text) + 1;
+        if (length > num_instances) {
+            MV_EF_FREE(instances);
+            instances = (float*)MV_EF_MALLOC(4*length*sizeof(float));
+            num_instances = length;
+        }
 
-    glDisable(GL_DEPTH_TEST);
+        float offset[2] = {job->offset[0], job->offset[1]};
+        int count = mv_ef_layout_string(batch->ctx, job->text, job->col, 0.0, 0.0, job->size, 0, instances);
+        mv_ef_render_palette(batch->ctx, &fb, instances, count, offset, job->size, job->palette ? job->palette : batch->ctx->colors, 1);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, font.texture_fontdata);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, font.texture_metadata);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_1D, font.texture_colors);
+        batch->done((int)index, &fb, batch->userdata);
+    }
 
-    // update bindings
-    glBindVertexArray(font.vao);
+    MV_EF_FREE(instances);
+    MV_EF_FREE(fb.pixels);
+}
 
-    // update uniforms
-    glUseProgram(font.program);
-    glUniform1f(glGetUniformLocation(font.program, "scale_factor"), size/font.font_size);
-    glUniform2fv(glGetUniformLocation(font.program, "string_offset"), 1, offset);
-    
-    GLint dims[4] = {0};
-    glGetIntegerv(GL_VIEWPORT, dims);
-    glUniform2f(glGetUniformLocation(font.program, "resolution"), dims[2], dims[3]);
+#ifndef MV_EF_NO_THREADS
+static MV_EF_THREAD_PROC(mv_ef_batch_thread)
+{
+    mv_ef_batch_work((mv_ef_batch*)arg);
+    return 0;
+}
+#endif
 
+//
+// Renders every job into an RGBA image and hands it to done(), on the worker thread that rendered it, 
+// so the images can be encoded in parallel. fb is reused for the worker's next job as soon as done() returns.
+// num_threads <= 0 uses every core, up to MV_EF_MAX_THREADS. returns the number of images rendered
+//
+int mv_ef_ctx_render_images(mv_ef_context *ctx, const mv_ef_image_job *jobs, int num_jobs, int num_threads, mv_ef_image_done done, void *userdata)
+{
+    if (!mv_ef_ctx_font_ready(ctx) || num_jobs <= 0)
+        return 0;
 
-    // actual uploading
-    glBindBuffer(GL_ARRAY_BUFFER, font.vbo_instances);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, 4*4*ctr, text_glyph_data);
+    // every glyph is added before the workers start, so they never write to the context
+    int num_images = 0;
+    for (int i = 0; i < num_jobs; i++) {
+        if (jobs[i].width <= 0 || jobs[i].height <= 0)
+            continue;
+        for (const char *c = jobs[i].text; *c; ) {
+            int codepoint = (unsigned char)*c < 0x80 ? *c++ : mv_ef_decode_utf8(&c);
+            mv_ef_ctx_glyph_slot(ctx, codepoint);
+        }
+        num_images++;
+    }
 
+    mv_ef_batch batch;
+    batch.ctx = ctx;
+    batch.jobs = jobs;
+    batch.num_jobs = num_jobs;
+    batch.done = done;
+    batch.userdata = userdata;
+    batch.next_job = 0;
 
-    // actual drawing
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, ctr);
+#ifndef MV_EF_NO_THREADS
+    if (num_threads <= 0)
+        num_threads = mv_ef_num_cpus();
+    if (num_threads > MV_EF_MAX_THREADS) num_threads = MV_EF_MAX_THREADS;
+    if (num_threads > num_jobs) num_threads = num_jobs;
 
-    // Restore modified GL state
-    glUseProgram(last_program);
-    
-    glActiveTexture(GL_TEXTURE0); 
-    glBindTexture(GL_TEXTURE_2D, last_texture0);
-    glActiveTexture(GL_TEXTURE1); 
-    glBindTexture(GL_TEXTURE_2D, last_texture1);
-    glActiveTexture(GL_TEXTURE2); 
-    glBindTexture(GL_TEXTURE_1D, last_texture2);
+    mv_ef_thread threads[MV_EF_MAX_THREADS];
+    int started[MV_EF_MAX_THREADS] = {0};
+    for (int i = 1; i < num_threads; i++)
+        started[i] = mv_ef_thread_create(&threads[i], mv_ef_batch_thread, &batch);
+    mv_ef_batch_work(&batch);
+    for (int i = 1; i < num_threads; i++)
+        if (started[i])
+            mv_ef_thread_join(threads[i]);
+#else
+    (void)num_threads;
+    mv_ef_batch_work(&batch);
+#endif
 
-    glBlendEquationSeparate(last_blend_equation_rgb, last_blend_equation_alpha);
-    glBindVertexArray(last_vertex_array);
-    glBlendFunc(last_blend_src, last_blend_dst);
-    
-    (last_enable_depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST));
-    (last_enable_blend ? glEnable(GL_BLEND) : glDisable(GL_BLEND));
+    return num_images;
 }
 
+int mv_ef_render_images(const mv_ef_image_job *jobs, int num_jobs, int num_threads, mv_ef_image_done done, void *userdata)
+{
+    return mv_ef_ctx_render_images(mv_ef_default_context(), jobs, num_jobs, num_threads, done, userdata);
+}
 
 // shader loading routines
 char *mv_ef_read_entire_file(const char *filename) {
     // Read content of "filename" and return it as a c-string.
-    printf("Reading %s\n", filename);
     FILE *f = fopen(filename, "rb");
     if (!f) {
-        printf("Error: Could not load shader file!\n");
+        printf("Error: Could not load shader file \"%s\"\n", filename);
         return NULL;
     }
 
     fseek(f, 0, SEEK_END);
     long fsize = ftell(f);
     fseek(f, 0, SEEK_SET);
-    printf("Filesize = %d\n", (int)fsize);
 
-    char *string = (char*)malloc(fsize + 1);
+    char *string = (char*)MV_EF_MALLOC(fsize + 1);
     fread(string, fsize, 1, f);
     string[fsize] = '\0';
     fclose(f);
@@ -512,51 +5470,75 @@ char vs_source[] = \
 \n\
 layout(location = 0) in vec2 vertexPosition;\n\
 layout(location = 1) in vec4 instanceGlyph;\n\
+layout(location = 2) in float instanceScale; // per glyph scale_factor multiplier, 1.0 except for labels\n\
+layout(location = 3) in float instanceLabel; // index into sampler_world, for world space labels\n\
 \n\
-uniform sampler2D sampler_font;\n\
+uniform sampler2DArray sampler_font;\n\
 uniform sampler2D sampler_meta;\n\
+uniform samplerBuffer sampler_world; // model matrix and billboard flag of every world space label\n\
+\n\
+layout(std140) uniform mv_ef_world {\n\
+    mat4 view_projection;\n\
+};\n\
+uniform float world_space;      // 1.0 to place the text with sampler_world and view_projection instead\n\
 \n\
 uniform float offset_firstline; // ascent - descent - linegap/2\n\
 uniform float scale_factor;     // scaling factor proportional to font size\n\
 uniform vec2 string_offset;     // offset of upper-left corner\n\
 \n\
-uniform vec2 res_meta;   // 96x2 \n\
-uniform vec2 res_bitmap; // 512x256\n\
+uniform vec2 res_meta;   // MV_EF_MAX_GLYPHS x 3 \n\
+uniform vec2 res_bitmap; // size of an atlas page\n\
 uniform vec2 resolution; // screen resolution\n\
 \n\
-out vec2 uv;\n\
+out vec3 uv;           // (u, v, layer) in the atlas\n\
 out float color_index; // for syntax highlighting\n\
 \n\
 void main()\n\
 {\n\
     // (xoff, yoff, xoff2, yoff2), from second row of texture\n\
-    vec4 q2 = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.75))*vec4(res_bitmap, res_bitmap);\n\
+    vec4 q2 = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 1.5/res_meta.y))*vec4(res_bitmap, res_bitmap);\n\
 \n\
     vec2 p = vertexPosition*(q2.zw - q2.xy) + q2.xy; // offset and scale it properly relative to baseline\n\
     p *= vec2(1.0, -1.0);                            // flip y, since texture is upside-down\n\
     p.y -= offset_firstline;                         // make sure the upper-left corner of the string is in the upper-left corner of the screen\n\
-    p *= scale_factor;                               // scale relative to font size\n\
+    p *= scale_factor*instanceScale;                 // scale relative to font size\n\
     p += instanceGlyph.xy + string_offset;           // move glyph into the right position\n\
-    p *= 2.0/resolution;                             // to NDC\n\
-    p += vec2(-1.0, 1.0);                            // move to upper-left corner instead of center\n\
 \n\
-    gl_Position = vec4(p, 0.0, 1.0);\n\
+    if (world_space > 0.5) {\n\
+        // p is in the plane of the label\n\
+        int label = 5*int(instanceLabel);\n\
+        mat4 model = mat4(texelFetch(sampler_world, label), texelFetch(sampler_world, label + 1),\n\
+                          texelFetch(sampler_world, label + 2), texelFetch(sampler_world, label + 3));\n\
+        if (texelFetch(sampler_world, label + 4).x > 0.5) {\n\
+            gl_Position = view_projection*model[3];            // billboard, projected origin\n\
+            gl_Position.xy += p*2.0/resolution*gl_Position.w; // plus pixels on the screen\n\
+        } else {\n\
+            gl_Position = view_projection*(model*vec4(p, 0.0, 1.0));\n\
+        }\n\
+    } else {\n\
+        p *= 2.0/resolution;                         // to NDC\n\
+        p += vec2(-1.0, 1.0);                        // move to upper-left corner instead of center\n\
+        gl_Position = vec4(p, 0.0, 1.0);\n\
+    }\n\
 \n\
     // (x0, y0, x1-x0, y1-y0), from first row of texture\n\
-    vec4 q = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.25));\n\
+    vec4 q = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 0.5/res_meta.y));\n\
+\n\
+    // atlas layer, from third row of texture\n\
+    float layer = texture(sampler_meta, vec2((instanceGlyph.z + 0.5)/res_meta.x, 2.5/res_meta.y)).x;\n\
 \n\
     // send the correct uv's in the font atlas to the fragment shader\n\
-    uv = q.xy + vertexPosition*q.zw;\n\
+    uv = vec3(q.xy + vertexPosition*q.zw, layer);\n\
     color_index = instanceGlyph.w;\n\
 }\n";
 
 char fs_source[] = \
 "#version 330 core\n\
 \n\
-in vec2 uv;\n\
+in vec3 uv;\n\
 in float color_index;\n\
 \n\
-uniform sampler2D sampler_font;\n\
+uniform sampler2DArray sampler_font;\n\
 uniform sampler1D sampler_colors;\n\
 uniform float num_colors;\n\
 \n\
@@ -569,76 +5551,226 @@ void main()\n\
     color = vec4(col, s);\n\
 }\n";
 
-GLuint mv_ef_load_shaders(const char * vertex_file_path,const char * fragment_file_path){
-    GLint Result = GL_FALSE;
-    int InfoLogLength;
+//
+// Shader program building, split in two so that the driver can compile while the atlas is rasterized:
+// mv_ef_begin_program() submits the compile and link without waiting for the result, 
+// and mv_ef_finish_program() checks the result later on.
+//
+// Linked programs are cached on disk with glGetProgramBinary() (GL 4.1), keyed by the driver's 
+// vendor, renderer and version strings and the shader sources, so later starts skip the compile.
+// With KHR_parallel_shader_compile the driver compiles on its own threads, and completion can be 
+// polled without blocking. the thread count can only be raised if the program defines 
+// MV_EF_GET_PROC_ADDRESS (e.g. glfwGetProcAddress), since glad doesn't load the extension
+//
+#define MV_EF_COMPLETION_STATUS_KHR 0x91B1
+#define MV_EF_PROGRAM_CACHE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    int version;
+    GLenum format;
+    unsigned long long key;
+    int length;
+    int pad;
+    // followed by the program binary
+} mv_ef_program_cache_header;
+
+static void mv_ef_program_cache_filename(char *name, int name_size, unsigned long long key)
+{
+    snprintf(name, name_size, "mv_ef_program_%016llx.bin", key);
+}
 
-    // Create the Vertex shader
-    GLuint VertexShaderID;
-    VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    char *VertexShaderCode = vertex_file_path ? mv_ef_read_entire_file(vertex_file_path) : vs_source;
+// a linked program from the binary cache, or 0. binaries are rejected by the driver when they don't fit it anymore
+static GLuint mv_ef_load_program_cache(unsigned long long key)
+{
+    char name[64], path[600];
+    mv_ef_program_cache_filename(name, sizeof(name), key);
+    if (!mv_ef_cache_path(path, sizeof(path), name))
+        return 0;
 
-    // Compile Vertex Shader
-    printf("Compiling shader : %s\n", vertex_file_path); fflush(stdout);
-    glShaderSource(VertexShaderID, 1, (const char**)&VertexShaderCode , NULL);
-    glCompileShader(VertexShaderID);
+    size_t size;
+    const unsigned char *data = mv_ef_map_file(path, &size);
+    if (!data)
+        return 0;
 
-    // Check Vertex Shader
-    glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+    mv_ef_program_cache_header header;
+    GLuint program = 0;
+    if (size >= sizeof(header)) {
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, "mv_ef_pb", 8) == 0 && header.version == MV_EF_PROGRAM_CACHE_VERSION && 
+            header.key == key && size == sizeof(header) + header.length) {
+            program = glCreateProgram();
+            glProgramBinary(program, header.format, data + sizeof(header), header.length);
 
-    if ( InfoLogLength > 0 ){
-        char VertexShaderErrorMessage[9999];
-        glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, VertexShaderErrorMessage);
-        printf("%s\n", VertexShaderErrorMessage); fflush(stdout);
+            GLint result = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &result);
+            if (!result) {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
     }
 
+    mv_ef_unmap_file(data, size);
+    return program;
+}
+
+static void mv_ef_save_program_cache(GLuint program, unsigned long long key)
+{
+    char name[64], path[600];
+    mv_ef_program_cache_filename(name, sizeof(name), key);
+    if (!mv_ef_cache_path(path, sizeof(path), name))
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    mv_ef_program_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "mv_ef_pb", 8);
+    header.version = MV_EF_PROGRAM_CACHE_VERSION;
+    header.key = key;
+
+    void *binary = MV_EF_MALLOC(length);
+    glGetProgramBinary(program, length, &header.length, &header.format, binary);
+    if (header.length > 0)
+        mv_ef_write_file_atomic(path, &header, sizeof(header), binary, header.length);
+    MV_EF_FREE(binary);
+}
+
+static unsigned long long mv_ef_program_cache_key(const char *vs_code, const char *fs_code)
+{
+    const char *strings[] = {(const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), 
+                             (const char*)glGetString(GL_VERSION), vs_code, fs_code};
+    unsigned long long h = MV_EF_PROGRAM_CACHE_VERSION;
+    for (int i = 0; i < 5; i++)
+        h = mv_ef_hash(strings[i] ? strings[i] : "", strings[i] ? strlen(strings[i]) + 1 : 1, h);
+    return h;
+}
+
+static GLuint mv_ef_compile_shader(GLenum type, const char *code)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static void mv_ef_print_shader_log(GLuint shader, const char *what)
+{
+    GLint result = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+    if (result)
+        return;
+
+    char message[4096] = {0};
+    glGetShaderInfoLog(shader, sizeof(message), NULL, message);
+    printf("Error: could not compile %s:\n%s\n", what, message); fflush(stdout);
+}
+
+//
+// Starts building the program, from the binary cache or from source. doesn't wait for the driver
+//
+static mv_ef_program_build mv_ef_begin_program(const char *vertex_file_path, const char *fragment_file_path)
+{
+    mv_ef_program_build build;
+    memset(&build, 0, sizeof(build));
+
+    char *vs_code = vertex_file_path ? mv_ef_read_entire_file(vertex_file_path) : vs_source;
+    char *fs_code = fragment_file_path ? mv_ef_read_entire_file(fragment_file_path) : fs_source;
+    if (!vs_code || !fs_code) {
+        if (vertex_file_path) MV_EF_FREE(vs_code);
+        if (fragment_file_path) MV_EF_FREE(fs_code);
+        return build;
+    }
 
-    // Create the Fragment shader
-    GLuint FragmentShaderID;
-    FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    char *FragmentShaderCode = fragment_file_path ? mv_ef_read_entire_file(fragment_file_path) : fs_source;
+    GLint num_formats = 0;
+    if (mv_ef_has_gl(4, 1, "GL_ARB_get_program_binary"))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if (num_formats > 0) {
+        build.key = mv_ef_program_cache_key(vs_code, fs_code);
+        build.program = mv_ef_load_program_cache(build.key);
+    }
 
-    // Compile Fragment Shader
-    printf("Compiling shader : %s\n", fragment_file_path); fflush(stdout);
-    glShaderSource(FragmentShaderID, 1, (const char**)&FragmentShaderCode , NULL);
-    glCompileShader(FragmentShaderID);
+    if (!build.program) {
+        build.parallel = mv_ef_has_extension("GL_KHR_parallel_shader_compile") || 
+                         mv_ef_has_extension("GL_ARB_parallel_shader_compile");
+#ifdef MV_EF_GET_PROC_ADDRESS
+        if (build.parallel) {
+            typedef void (APIENTRY *max_threads_proc)(GLuint count);
+            max_threads_proc max_threads = (max_threads_proc)MV_EF_GET_PROC_ADDRESS("glMaxShaderCompilerThreadsKHR");
+            if (max_threads) 
+                max_threads(0xFFFFFFFF); // as many as the driver wants
+        }
+#endif
 
+        build.vs = mv_ef_compile_shader(GL_VERTEX_SHADER, vs_code);
+        build.fs = mv_ef_compile_shader(GL_FRAGMENT_SHADER, fs_code);
 
-    // Check Fragment Shader
-    glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-    glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-    if ( InfoLogLength > 0 ){
-        char FragmentShaderErrorMessage[9999];
-        glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, FragmentShaderErrorMessage);
-        printf("%s\n", FragmentShaderErrorMessage); fflush(stdout);
+        build.program = glCreateProgram();
+        if (build.key)
+            glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(build.program, build.vs);
+        glAttachShader(build.program, build.fs);
+        glLinkProgram(build.program);
     }
 
+    if (vertex_file_path) MV_EF_FREE(vs_code);
+    if (fragment_file_path) MV_EF_FREE(fs_code);
+
+    return build;
+}
+
+//
+// Checks the result of mv_ef_begin_program(), and stores freshly linked programs in the binary cache.
+// returns 1 when the program is ready, 0 if it failed (the program is then 0) and -1 if the driver 
+// is still working on it. only returns -1 when not waiting, and only with parallel shader compilation
+//
+static int mv_ef_finish_program(mv_ef_program_build *build, int wait)
+{
+    if (!build->program)
+        return 0;
+    if (!build->vs)
+        return 1; // from the binary cache, already checked
+
+    if (!wait && build->parallel) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(build->program, MV_EF_COMPLETION_STATUS_KHR, &done);
+        if (!done)
+            return -1;
+    }
 
-    // Create and Link the program
-    printf("Linking program\n"); fflush(stdout);
-    GLuint ProgramID;
-    ProgramID= glCreateProgram();
-    glAttachShader(ProgramID, VertexShaderID);
-    glAttachShader(ProgramID, FragmentShaderID);
-    glLinkProgram(ProgramID);
+    GLint result = GL_FALSE;
+    glGetProgramiv(build->program, GL_LINK_STATUS, &result);
+    if (result) {
+        if (build->key)
+            mv_ef_save_program_cache(build->program, build->key);
+    } else {
+        mv_ef_print_shader_log(build->vs, "vertex shader");
+        mv_ef_print_shader_log(build->fs, "fragment shader");
 
-    // Check the program
-    glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-    glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+        char message[4096] = {0};
+        glGetProgramInfoLog(build->program, sizeof(message), NULL, message);
+        printf("Error: could not link shader program:\n%s\n", message); fflush(stdout);
 
-    if ( InfoLogLength > 0 ){
-        GLchar ProgramErrorMessage[9999];
-        glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-        printf("%s\n", &ProgramErrorMessage[0]); fflush(stdout);
+        glDeleteProgram(build->program);
+        build->program = 0;
     }
 
-    glDeleteShader(VertexShaderID);
-    glDeleteShader(FragmentShaderID);
-    if (fragment_file_path) free(FragmentShaderCode);
-    if (vertex_file_path) free(VertexShaderCode);
+    glDeleteShader(build->vs);
+    glDeleteShader(build->fs);
+    build->vs = build->fs = 0;
+
+    return build->program != 0;
+}
 
-    return ProgramID;
+GLuint mv_ef_load_shaders(const char *vertex_file_path, const char *fragment_file_path)
+{
+    mv_ef_program_build build = mv_ef_begin_program(vertex_file_path, fragment_file_path);
+    mv_ef_finish_program(&build, 1);
+    return build.program;
 }
 
 
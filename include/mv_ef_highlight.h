@@ -0,0 +1,464 @@
+#ifndef MV_EF_HIGHLIGHT_H
+#define MV_EF_HIGHLIGHT_H
+
+//
+// GLSL syntax highlighting, for the col argument of mv_ef_draw(). every byte of a source gets the type 
+// of the token it's part of, which is also its color index. 
+//
+// Single pass over the source, which is only read: a table of character classes splits it into tokens, 
+// names are looked up in a perfect hash table of the keywords and types, and numbers are recognized by 
+// a small scanner. #define MV_EF_HIGHLIGHT_IMPLEMENTATION in one .c/.cpp file before including this
+//
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MV_EF_TOKEN_OTHER = 0, // names, and the whitespace between tokens
+    MV_EF_TOKEN_OPERATOR,
+    MV_EF_TOKEN_NUMERIC,
+    MV_EF_TOKEN_FUNCTION,  // a name followed directly by '('
+    MV_EF_TOKEN_KEYWORD,
+    MV_EF_TOKEN_COMMENT,
+    MV_EF_TOKEN_TYPE,
+    MV_EF_NUM_TOKEN_TYPES
+} mv_ef_token_type;
+
+typedef struct {
+    size_t start, end; // bytes of the token in the source
+    mv_ef_token_type type;
+} mv_ef_token;
+
+extern const char *mv_ef_token_names[MV_EF_NUM_TOKEN_TYPES];
+
+// the next token at or after *pos, which is moved past it. returns 0 at the end of the source
+int mv_ef_glsl_next_token(const char *str, size_t length, size_t *pos, mv_ef_token *token);
+
+// writes the token type of every one of the length bytes of str to col
+void mv_ef_highlight_glsl(const char *str, size_t length, char *col);
+
+//
+// Streaming highlighting, for sources that arrive in pieces, e.g. read from a file a block at a time.
+// the source can be split anywhere, even inside a comment or a name, and the stream only keeps a few bytes
+// of state. the colors are written as the tokens are recognized, into col, one per byte of the whole source,
+// and/or into the colors of glyph instances, one per glyph as mv_ef_draw() lays them out
+// (every utf-8 codepoint but '\n'), e.g. &instances[0].color with a stride of 4 for mv_ef_map_instances()
+//
+#define MV_EF_GLSL_NAME_PREFIX 16 // bytes kept of a name, longer than any keyword or type
+
+typedef struct {
+    char *col;                  // or NULL
+    float *instance_colors;     // or NULL
+    size_t instance_stride;     // in floats
+
+    int state;                  // what the last piece left open, a name, a comment, ...
+    size_t pos, glyphs;         // bytes and glyphs so far
+    size_t token_start, token_glyph; // of the open name or '/', colored once it's known what they are
+    unsigned char name[MV_EF_GLSL_NAME_PREFIX];
+    size_t name_length;
+} mv_ef_glsl_stream;
+
+void mv_ef_glsl_stream_begin(mv_ef_glsl_stream *stream, char *col, float *instance_colors, size_t instance_stride);
+void mv_ef_glsl_stream_feed(mv_ef_glsl_stream *stream, const char *str, size_t length);
+// colors what the end of the source left open
+void mv_ef_glsl_stream_end(mv_ef_glsl_stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MV_EF_HIGHLIGHT_H
+
+
+#ifdef MV_EF_HIGHLIGHT_IMPLEMENTATION
+
+#include <string.h>
+
+const char *mv_ef_token_names[MV_EF_NUM_TOKEN_TYPES] = {"other", "operator", "numeric", "function", "keyword", "comment", "type"};
+
+// character classes. names and numbers run until the next space or operator, 
+// and every operator is a token of its own, or the start of a comment
+#define MV_EF_CHAR_NAME     0
+#define MV_EF_CHAR_SPACE    1 // whitespace and the punctuation " ,(){}[];", not part of any token
+#define MV_EF_CHAR_OPERATOR 2 // "/+-*<>=&|"
+
+static const unsigned char mv_ef_char_class[256] = {
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 2, 0, 1, 1, 2, 2, 1, 2, 0, 2,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 2, 2, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+//
+// Keywords and types, at the index of their hash. the multipliers of mv_ef_glsl_word_hash() were searched for 
+// to have no collisions among these words, so a name is one lookup and one comparison. 
+// when changing the words, search for new ones and move the words to their new indices
+//
+typedef struct {
+    const char *word;
+    size_t length;
+    mv_ef_token_type type;
+} mv_ef_glsl_word;
+
+static const mv_ef_glsl_word mv_ef_glsl_words[32] = {
+    {"while",     5, MV_EF_TOKEN_KEYWORD},
+    {"sampler2D", 9, MV_EF_TOKEN_TYPE},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"void",      4, MV_EF_TOKEN_TYPE},
+    {"vec3",      4, MV_EF_TOKEN_TYPE},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"#define",   7, MV_EF_TOKEN_KEYWORD},
+    {"vec4",      4, MV_EF_TOKEN_TYPE},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"else",      4, MV_EF_TOKEN_KEYWORD},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"return",    6, MV_EF_TOKEN_KEYWORD},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"uniform",   7, MV_EF_TOKEN_KEYWORD},
+    {"if",        2, MV_EF_TOKEN_KEYWORD},
+    {"for",       3, MV_EF_TOKEN_KEYWORD},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"layout",    6, MV_EF_TOKEN_KEYWORD},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"out",       3, MV_EF_TOKEN_KEYWORD},
+    {"in",        2, MV_EF_TOKEN_KEYWORD},
+    {"sampler1D", 9, MV_EF_TOKEN_TYPE},
+    {"int",       3, MV_EF_TOKEN_TYPE},
+    {"float",     5, MV_EF_TOKEN_TYPE},
+    {"#version",  8, MV_EF_TOKEN_KEYWORD},
+    {"",          0, MV_EF_TOKEN_OTHER},
+    {"vec2",      4, MV_EF_TOKEN_TYPE},
+};
+
+// for names of 2 bytes or more
+static unsigned int mv_ef_glsl_word_hash(const unsigned char *name, size_t length)
+{
+    return (2*name[0] + 7*name[length-2] + 5*name[length-1] + (unsigned int)length) & 31;
+}
+
+static int mv_ef_is_digit(int c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int mv_ef_is_hex_digit(int c)
+{
+    return mv_ef_is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+//
+// The length of the numeric literal at the start of a name, 0 if it doesn't start with one: 
+// decimal, octal or hex integers, floats with a fraction and/or exponent, and the suffixes u, f and lf.
+// signs are operators, so "1e-5" is the names "1e" and "5", both numeric
+//
+static size_t mv_ef_scan_number(const unsigned char *name, size_t length)
+{
+    size_t i = 0;
+    if (length >= 3 && name[0] == '0' && (name[1] == 'x' || name[1] == 'X') && mv_ef_is_hex_digit(name[2])) {
+        for (i = 2; i < length && mv_ef_is_hex_digit(name[i]); i++) {}
+    } else {
+        size_t digits = 0;
+        for (; i < length && mv_ef_is_digit(name[i]); i++, digits++) {}
+        if (i < length && name[i] == '.')
+            for (i++; i < length && mv_ef_is_digit(name[i]); i++, digits++) {}
+        if (digits == 0)
+            return 0;
+
+        if (i < length && (name[i] == 'e' || name[i] == 'E')) {
+            size_t e = i + 1;
+            if (e < length && mv_ef_is_digit(name[e])) {
+                for (; e < length && mv_ef_is_digit(name[e]); e++) {}
+                i = e;
+            } else if (e == length) {
+                i = e; // the exponent's sign and digits are the next tokens
+            }
+        }
+    }
+
+    if (i < length && (name[i] == 'u' || name[i] == 'U' || name[i] == 'f' || name[i] == 'F'))
+        i++;
+    else if (i + 1 < length && (name[i] == 'l' || name[i] == 'L') && (name[i+1] == 'f' || name[i+1] == 'F'))
+        i += 2;
+    return i;
+}
+
+// next is the byte after the name, 0 at the end of the source
+static mv_ef_token_type mv_ef_glsl_classify(const unsigned char *name, size_t length, int next)
+{
+    mv_ef_token_type word = MV_EF_TOKEN_OTHER;
+    if (length >= 2) {
+        const mv_ef_glsl_word *w = &mv_ef_glsl_words[mv_ef_glsl_word_hash(name, length)];
+        if (w->length == length && memcmp(w->word, name, length) == 0)
+            word = w->type;
+    }
+
+    // keywords take precedence over calls, and calls over numbers and types, e.g. vec4(...)
+    if (word == MV_EF_TOKEN_KEYWORD)
+        return MV_EF_TOKEN_KEYWORD;
+    if (next == '(')
+        return MV_EF_TOKEN_FUNCTION;
+    if (mv_ef_scan_number(name, length) > 0)
+        return MV_EF_TOKEN_NUMERIC;
+    return word;
+}
+
+int mv_ef_glsl_next_token(const char *str, size_t length, size_t *pos, mv_ef_token *token)
+{
+    const unsigned char *s = (const unsigned char*)str;
+    size_t i = *pos;
+    while (i < length && mv_ef_char_class[s[i]] == MV_EF_CHAR_SPACE)
+        i++;
+    if (i >= length) {
+        *pos = length;
+        return 0;
+    }
+
+    token->start = i;
+    if (s[i] == '/' && i + 1 < length && s[i+1] == '/') {
+        // up to the end of the line
+        const unsigned char *eol = (const unsigned char*)memchr(s + i, '\n', length - i);
+        i = eol ? (size_t)(eol - s) : length;
+        token->type = MV_EF_TOKEN_COMMENT;
+    } else if (s[i] == '/' && i + 1 < length && s[i+1] == '*') {
+        // through the closing */, or up to the end of the source
+        i += 2;
+        for (;;) {
+            const unsigned char *star = (const unsigned char*)memchr(s + i, '*', length - i);
+            if (!star) {
+                i = length;
+                break;
+            }
+            i = star - s + 1;
+            if (i < length && s[i] == '/') {
+                i++;
+                break;
+            }
+        }
+        token->type = MV_EF_TOKEN_COMMENT;
+    } else if (mv_ef_char_class[s[i]] == MV_EF_CHAR_OPERATOR) {
+        i++;
+        token->type = MV_EF_TOKEN_OPERATOR;
+    } else {
+        while (i < length && mv_ef_char_class[s[i]] == MV_EF_CHAR_NAME)
+            i++;
+        token->type = mv_ef_glsl_classify(s + token->start, i - token->start, i < length ? s[i] : 0);
+    }
+
+    token->end = i;
+    *pos = i;
+    return 1;
+}
+
+void mv_ef_highlight_glsl(const char *str, size_t length, char *col)
+{
+    size_t pos = 0, colored = 0;
+    mv_ef_token token;
+    while (mv_ef_glsl_next_token(str, length, &pos, &token)) {
+        memset(col + colored, MV_EF_TOKEN_OTHER, token.start - colored);
+        memset(col + token.start, token.type, token.end - token.start);
+        colored = token.end;
+    }
+    memset(col + colored, MV_EF_TOKEN_OTHER, length - colored);
+}
+
+//
+// Streaming. tokens that end inside a piece are handled like mv_ef_glsl_next_token() does, and only
+// names and a '/' that run into the next piece are left open. for a whole source in memory,
+// mv_ef_highlight_glsl() is a bit faster, as it has none of this to keep track of
+//
+// the states a piece of the source can end in
+enum {
+    MV_EF_GLSL_BETWEEN = 0,          // between tokens
+    MV_EF_GLSL_SLASH,                // after a '/', an operator or the start of a comment
+    MV_EF_GLSL_NAME,
+    MV_EF_GLSL_LINE_COMMENT,
+    MV_EF_GLSL_BLOCK_COMMENT,
+    MV_EF_GLSL_BLOCK_COMMENT_STAR    // after a '*' in a block comment, which a '/' closes
+};
+
+void mv_ef_glsl_stream_begin(mv_ef_glsl_stream *stream, char *col, float *instance_colors, size_t instance_stride)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->col = col;
+    stream->instance_colors = instance_colors;
+    stream->instance_stride = instance_stride;
+}
+
+// moves past n bytes, coloring them with type, or only counting them with -1
+static void mv_ef_glsl_advance(mv_ef_glsl_stream *stream, const unsigned char *s, size_t n, int type)
+{
+    if (stream->col && type >= 0)
+        memset(stream->col + stream->pos, type, n);
+    if (stream->instance_colors) {
+        for (size_t i = 0; i < n; i++) {
+            if (s[i] == '\n' || (s[i] & 0xC0) == 0x80)
+                continue;
+            if (type >= 0)
+                stream->instance_colors[stream->instance_stride*stream->glyphs] = (float)type;
+            stream->glyphs++;
+        }
+    }
+    stream->pos += n;
+}
+
+// colors the open name or '/', up to here
+static void mv_ef_glsl_close_token(mv_ef_glsl_stream *stream, mv_ef_token_type type)
+{
+    if (stream->col)
+        memset(stream->col + stream->token_start, type, stream->pos - stream->token_start);
+    if (stream->instance_colors) {
+        for (size_t g = stream->token_glyph; g < stream->glyphs; g++)
+            stream->instance_colors[stream->instance_stride*g] = (float)type;
+    }
+    stream->state = MV_EF_GLSL_BETWEEN;
+}
+
+// a longer name is only looked at up to its prefix, which can't change what it is
+static void mv_ef_glsl_close_name(mv_ef_glsl_stream *stream, int next)
+{
+    size_t length = stream->name_length < MV_EF_GLSL_NAME_PREFIX ? stream->name_length : MV_EF_GLSL_NAME_PREFIX;
+    mv_ef_glsl_close_token(stream, mv_ef_glsl_classify(stream->name, length, next));
+}
+
+void mv_ef_glsl_stream_feed(mv_ef_glsl_stream *user_stream, const char *str, size_t length)
+{
+    // a local copy, which the compiler can keep in registers across the calls to memset
+    mv_ef_glsl_stream local = *user_stream, *stream = &local;
+
+    const unsigned char *s = (const unsigned char*)str, *end = s + length;
+    while (s < end) {
+        const unsigned char *p = s;
+        switch (stream->state) {
+        case MV_EF_GLSL_BETWEEN:
+            // the common case, tokens that end in this piece are colored right away
+            while (s < end && stream->state == MV_EF_GLSL_BETWEEN) {
+                p = s;
+                while (p < end && mv_ef_char_class[*p] == MV_EF_CHAR_SPACE)
+                    p++;
+                mv_ef_glsl_advance(stream, s, p - s, MV_EF_TOKEN_OTHER);
+                s = p;
+                if (s == end)
+                    break;
+
+                if (mv_ef_char_class[*s] == MV_EF_CHAR_OPERATOR) {
+                    if (*s == '/' && s + 1 < end && (s[1] == '/' || s[1] == '*')) {
+                        stream->state = s[1] == '/' ? MV_EF_GLSL_LINE_COMMENT : MV_EF_GLSL_BLOCK_COMMENT;
+                        mv_ef_glsl_advance(stream, s, 2, MV_EF_TOKEN_COMMENT);
+                        s += 2;
+                    } else if (*s == '/' && s + 1 == end) {
+                        stream->state = MV_EF_GLSL_SLASH;
+                        stream->token_start = stream->pos;
+                        stream->token_glyph = stream->glyphs;
+                        mv_ef_glsl_advance(stream, s++, 1, -1);
+                    } else {
+                        mv_ef_glsl_advance(stream, s++, 1, MV_EF_TOKEN_OPERATOR);
+                    }
+                    continue;
+                }
+
+                while (p < end && mv_ef_char_class[*p] == MV_EF_CHAR_NAME)
+                    p++;
+                if (p < end) {
+                    mv_ef_glsl_advance(stream, s, p - s, mv_ef_glsl_classify(s, p - s, *p));
+                    s = p;
+                    continue;
+                }
+                // runs into the next piece
+                stream->state = MV_EF_GLSL_NAME;
+                stream->token_start = stream->pos;
+                stream->token_glyph = stream->glyphs;
+                stream->name_length = 0;
+            }
+            break;
+
+        case MV_EF_GLSL_SLASH:
+            if (*s == '/' || *s == '*') {
+                mv_ef_glsl_close_token(stream, MV_EF_TOKEN_COMMENT);
+                stream->state = *s == '/' ? MV_EF_GLSL_LINE_COMMENT : MV_EF_GLSL_BLOCK_COMMENT;
+                mv_ef_glsl_advance(stream, s++, 1, MV_EF_TOKEN_COMMENT);
+            } else {
+                mv_ef_glsl_close_token(stream, MV_EF_TOKEN_OPERATOR);
+            }
+            break;
+
+        case MV_EF_GLSL_NAME:
+            while (p < end && mv_ef_char_class[*p] == MV_EF_CHAR_NAME)
+                p++;
+            if (stream->name_length < MV_EF_GLSL_NAME_PREFIX) {
+                size_t keep = MV_EF_GLSL_NAME_PREFIX - stream->name_length;
+                if (keep > (size_t)(p - s))
+                    keep = p - s;
+                memcpy(stream->name + stream->name_length, s, keep);
+            }
+            stream->name_length += p - s;
+            mv_ef_glsl_advance(stream, s, p - s, -1);
+            s = p;
+            if (s < end)
+                mv_ef_glsl_close_name(stream, *s);
+            break;
+
+        case MV_EF_GLSL_LINE_COMMENT:
+            p = (const unsigned char*)memchr(s, '\n', end - s);
+            if (!p)
+                p = end;
+            else
+                stream->state = MV_EF_GLSL_BETWEEN;
+            mv_ef_glsl_advance(stream, s, p - s, MV_EF_TOKEN_COMMENT);
+            s = p;
+            break;
+
+        case MV_EF_GLSL_BLOCK_COMMENT:
+            p = (const unsigned char*)memchr(s, '*', end - s);
+            if (!p) {
+                p = end;
+            } else {
+                p++;
+                stream->state = MV_EF_GLSL_BLOCK_COMMENT_STAR;
+            }
+            mv_ef_glsl_advance(stream, s, p - s, MV_EF_TOKEN_COMMENT);
+            s = p;
+            break;
+
+        case MV_EF_GLSL_BLOCK_COMMENT_STAR:
+            if (*s == '/') {
+                mv_ef_glsl_advance(stream, s++, 1, MV_EF_TOKEN_COMMENT);
+                stream->state = MV_EF_GLSL_BETWEEN;
+            } else {
+                stream->state = MV_EF_GLSL_BLOCK_COMMENT;
+            }
+            break;
+        }
+    }
+
+    *user_stream = local;
+}
+
+void mv_ef_glsl_stream_end(mv_ef_glsl_stream *stream)
+{
+    if (stream->state == MV_EF_GLSL_NAME)
+        mv_ef_glsl_close_name(stream, 0);
+    else if (stream->state == MV_EF_GLSL_SLASH)
+        mv_ef_glsl_close_token(stream, MV_EF_TOKEN_OPERATOR);
+    stream->state = MV_EF_GLSL_BETWEEN;
+}
+
+#endif // MV_EF_HIGHLIGHT_IMPLEMENTATION
@@ -9,6 +9,7 @@
 
 #include "stb_truetype.h" 
 #include "mv_easy_font.h"
+#include "mv_ef_highlight.h"
 
 /*
     Uniform random numbers between 0.0 (inclusive) and 1.0 (exclusive)
@@ -30,12 +31,23 @@ int clickedButtons = 0; // bit field for mouse clicks
 
 int SKIP_DRAWING = 0;
 
+// small text benchmark, toggled with B. draws a screen full of random glyphs at bench_font_size
+// and shows the gpu time of the draw in the window title, to measure fragment throughput 
+// when the atlas is heavily minified (see MV_EF_MIP_LEVELS)
+int BENCH_SMALL_TEXT = 0;
+float bench_font_size = 8.0;
+double bench_gpu_ms = 0.0;
+
+// pressing C compares the next frame with the same text drawn by the software renderer
+int COMPARE_CPU = 0;
+
 enum buttonMaps { FIRST_BUTTON=1, SECOND_BUTTON=2, THIRD_BUTTON=4, FOURTH_BUTTON=8, FIFTH_BUTTON=16, NO_BUTTON=0 };
 enum modifierMaps { CTRL=2, SHIFT=1, ALT=4, META=8, NO_MODIFIER=0 };
 
 // all glfw and opengl init here
 void init_GL();
 void frame_timer();
+void compare_cpu_rendering(char *str, char *col, float offset[2], float font_size);
 
 // callback functions to send to glfw
 void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods);
@@ -45,228 +57,16 @@ void mousewheel_callback(GLFWwindow* win, double xoffset, double yoffset);
 void windowsize_callback(GLFWwindow *win, int width, int height);
 
 
-typedef enum Token_Type {TOKEN_OTHER=0, TOKEN_OPERATOR, TOKEN_NUMERIC, TOKEN_FUNCTION, TOKEN_KEYWORD, TOKEN_COMMENT, TOKEN_VARIABLE, TOKEN_UNSET} Token_Type;
-
-const char *TOKEN_NAMES[] = {"other", "operator", "numeric", "function", "keyword", "comment", "type", "unset"};
-const char *TYPES[] = {"void", "int", "float", "vec2", "vec3", "vec4", "sampler1D", "sampler2D"};
-const char *KEYWORDS[] = {"#version", "#define", "in", "out", "uniform", "layout", "return", "if", "else", "for", "while"};
-
-typedef struct Token 
-{
-    char *start;
-    char *stop;
-    Token_Type type;
-} Token;
-
-
-// syntax highlighter
-void color_string(char *str, char *col)
-{
-    // ignored characters
-    char delims[] = " ,(){}[];\t\n";
-    int num_delims = strlen(delims);
-
-    char operators[] = "/+-*<>=&|";
-    int num_operators = strlen(operators);
-
-    Token tokens[9999]; // hurr
-    int num_tokens = 0; // running counter
-
-    char *ptr = str;
-    while (*ptr) {
-        // skip delimiters
-        int is_delim = 0;
-        for (int i = 0; i < num_delims; i++) {
-            if (*ptr == delims[i]) {
-                is_delim = 1;
-                break;
-            }
-        }
-
-        if (is_delim == 1) {
-            ptr++;
-            continue;
-        }
-
-        // found a token!
-        char *start = ptr;
-
-        if (*ptr == '/' && *(ptr+1) == '/') {
-            // found a line comment, go to end of line or end of file
-            while (*ptr != '\n' && *ptr != '\0') {
-                ptr++;
-            }
-
-            tokens[num_tokens].start = start;
-            tokens[num_tokens].stop = ptr;
-            tokens[num_tokens].type = TOKEN_COMMENT;
-            num_tokens++;
-
-            ptr++;
-            continue;
-        }
-
-        if (*ptr == '/' && *(ptr+1) == '*') {
-            // found a block comment, go to end of line or end of file
-            while (!(*ptr == '*' && *(ptr+1) == '/') && *ptr != '\0') {
-                ptr++;
-            }
-            ptr++;
-
-            tokens[num_tokens].start = start;
-            tokens[num_tokens].stop = ptr+1;
-            tokens[num_tokens].type = TOKEN_COMMENT;
-            num_tokens++;
-
-            ptr++;
-            continue;
-        } 
-
-        // check if it's an operator
-        int is_operator = 0;
-        for (int i = 0; i < num_operators; i++) {
-            if (*ptr == operators[i]) {
-                is_operator = 1;
-                break;
-            }
-        }
-
-        if (is_operator == 1) {
-            tokens[num_tokens].start = start;
-            tokens[num_tokens].stop = ptr+1;
-            tokens[num_tokens].type = TOKEN_OPERATOR;
-            num_tokens++;
-            ptr++;
-            continue;
-        } 
-
-        // it's either a name, type, a keyword, a function, or an names separated by an operator without spaces
-        while (*ptr) {
-            // check whether it's an operator stuck between two names
-            int is_operator2 = 0;
-            for (int i = 0; i < num_operators; i++) {
-                if (*ptr == operators[i]) {
-                    is_operator2 = 1;
-                    break;
-                }
-            }
-
-            if (is_operator2 == 1) {
-                tokens[num_tokens].start = start;
-                tokens[num_tokens].stop = ptr;
-                tokens[num_tokens].type = TOKEN_UNSET;
-                num_tokens++;
-                break;
-            }
-
-            // otherwise go until we find the next delimiter
-            int is_delim2 = 0;
-            for (int i = 0; i < num_delims; i++) {
-                if (*ptr == delims[i]) {
-                    is_delim2 = 1;
-                    break;
-                }
-            }
-
-            if (is_delim2 == 1) {
-                tokens[num_tokens].start = start;
-                tokens[num_tokens].stop = ptr;
-                tokens[num_tokens].type = TOKEN_UNSET;
-                num_tokens++;
-                ptr++;
-                break;
-            } 
-
-            // did not find delimiter, check next char
-            ptr++; 
-        }
-    }
-
-    // determine the types of the unset tokens, i.e. either
-    // a name, a type, a keyword, or a function
-    int num_keywords = sizeof(KEYWORDS)/sizeof(char*);
-    int num_types = sizeof(TYPES)/sizeof(char*);
-
-    for (int i = 0; i < num_tokens; i++) {
-        // TOKEN_OPERATOR and TOKEN_COMMENT should already be set, so skip those
-        if (tokens[i].type != TOKEN_UNSET) {
-            continue;
-        }
-
-        char end_char = *tokens[i].stop;
-
-        // temporarily null terminate at end of token, restored after parsing
-        *tokens[i].stop = '\0';
-
-        // parse
-        
-        // if it's a keyword
-        int is_keyword = 0;
-        for (int j = 0; j < num_keywords; j++) {
-            if (strcmp(tokens[i].start, KEYWORDS[j]) == 0) {
-                is_keyword = 1;
-                break;
-            }
-        }
-        if (is_keyword == 1) {
-            tokens[i].type = TOKEN_KEYWORD;
-            *tokens[i].stop = end_char;
-            continue;
-        } 
-
-        // Check if it's a function
-        float f;
-        if (end_char == '(') {
-            tokens[i].type = TOKEN_FUNCTION;
-            *tokens[i].stop = end_char;
-            continue;
-        } 
-
-        // or if it's a numeric value. catches both integers and floats
-        if (sscanf(tokens[i].start, "%f", &f) == 1) {
-            tokens[i].type = TOKEN_NUMERIC;
-            *tokens[i].stop = end_char;
-            continue;
-        } 
-
-        // if it's a variable type
-        int is_type = 0;
-        for (int j = 0; j < num_types; j++) {
-            if (strcmp(tokens[i].start, TYPES[j]) == 0) {
-                is_type = 1;
-                break;
-            }
-        }
-        if (is_type == 1) {
-            tokens[i].type = TOKEN_VARIABLE;
-            *tokens[i].stop = end_char;
-            continue;
-        } 
-
-        // otherwise it's a regular variable name 
-        tokens[i].type = TOKEN_OTHER;
-        *tokens[i].stop = end_char;
-    }
-    
-    // print all tokens and their types
-    for (int i = 0; i < num_tokens; i++) {
-
-        for (char *p = tokens[i].start; p != tokens[i].stop; p++) {
-            col[(p - str)] = tokens[i].type;
-        }
-    }
-}
 int main(int argc, char *argv[]) 
 {
     init_GL();
 
-    if (argc == 2) {
-        mv_ef_init(argv[1], 48.0, NULL, NULL);
-    }
+    // loads in the background, the text shows up once the font is ready
+    mv_ef_init_async(argc == 2 ? argv[1] : NULL, 48.0, NULL, NULL);
 
     char *fragment_source = mv_ef_read_entire_file("extra/vertex_shader_text.vs");
     char *col = (char*)calloc(strlen(fragment_source), 1);
-    color_string(fragment_source, col); // syntax highlighting
+    mv_ef_highlight_glsl(fragment_source, strlen(fragment_source), col); // syntax highlighting
 
     glfwSwapInterval(1);
     while ( !glfwWindowShouldClose(window)) {
@@ -277,29 +77,49 @@ int main(int argc, char *argv[])
         
         if (SKIP_DRAWING == 0) {       
             float offset[2] = {0.0, 0.0};
-            float font_size = 18.0;
-
-            float width, height;
-            mv_ef_string_dimensions(fragment_source, &width, &height, font_size); // for potential alignment
-            mv_ef_draw(fragment_source, col, offset, font_size);
-            
-            /*
-            float font_size = 8.0;
-            char str[MAX_STRING_LEN] = {0};
-            
-            int i = 0;
-            int ny = 106;
-            int nx = 363;
-            for (int j = 0; j < ny; j++) {
-                for (int i = 0; i < nx-1; i++) {
-                    int k = j*nx + i;
-                    str[k] = 32 + 96*rng();
+
+            if (BENCH_SMALL_TEXT == 0) {
+                float font_size = 18.0;
+
+                float width, height;
+                mv_ef_string_dimensions(fragment_source, &width, &height, font_size); // for potential alignment
+                mv_ef_draw(fragment_source, col, offset, font_size);
+
+                if (COMPARE_CPU && mv_ef_font_ready()) {
+                    compare_cpu_rendering(fragment_source, col, offset, font_size);
+                    COMPARE_CPU = 0;
                 }
-                str[j*nx + nx-1] = '\n';
-            }
+            } else {
+                static char str[MAX_STRING_LEN] = {0};
+                static GLuint queries[2] = {0};
+                static int frame = 0;
+
+                if (queries[0] == 0) {
+                    int ny = 106;
+                    int nx = 363;
+                    for (int j = 0; j < ny; j++) {
+                        for (int i = 0; i < nx-1; i++) {
+                            int k = j*nx + i;
+                            str[k] = 32 + 96*rng();
+                        }
+                        str[j*nx + nx-1] = '\n';
+                    }
+
+                    glGenQueries(2, queries);
+                }
+
+                // time this frame's draw, and read back the previous frame's query to avoid stalling
+                glBeginQuery(GL_TIME_ELAPSED, queries[frame%2]);
+                mv_ef_draw(str, NULL, offset, bench_font_size);
+                glEndQuery(GL_TIME_ELAPSED);
 
-            mv_ef_draw(str, NULL, offset, font_size);
-            */
+                if (frame > 0) {
+                    GLuint64 ns;
+                    glGetQueryObjectui64v(queries[(frame+1)%2], GL_QUERY_RESULT, &ns);
+                    bench_gpu_ms = 0.95*bench_gpu_ms + 0.05*ns/1e6;
+                }
+                frame++;
+            }
         }
 
         glfwSwapBuffers(window);
@@ -335,8 +155,13 @@ void frame_timer()
         double std_dt = sqrt(avg_dt2 - avg_dt*avg_dt);
         double ste_dt = std_dt / sqrt(num_samples);
 
-        char window_title_string[128];
+        char window_title_string[256];
         sprintf(window_title_string, "dt: avg = %.3fms, std = %.3fms, ste = %.4fms. fps = %.1f", 1000.0*avg_dt, 1000.0*std_dt, 1000.0*ste_dt, 1.0/avg_dt);
+        if (BENCH_SMALL_TEXT) {
+            char bench_string[128];
+            sprintf(bench_string, ". small text: size = %.0f, gpu = %.3fms", bench_font_size, bench_gpu_ms);
+            strcat(window_title_string, bench_string);
+        }
         glfwSetWindowTitle(window, window_title_string);
 
         num_samples = 1.0/avg_dt;
@@ -347,6 +172,56 @@ void frame_timer()
     }
 }
 
+// reads back the frame and prints how much it differs from the software rendered text
+void compare_cpu_rendering(char *str, char *col, float offset[2], float font_size)
+{
+    GLint dims[4] = {0};
+    glGetIntegerv(GL_VIEWPORT, dims);
+    int w = dims[2], h = dims[3];
+
+    unsigned char *gpu = (unsigned char*)malloc(4*w*h);
+    unsigned char *cpu = (unsigned char*)malloc(4*w*h);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, gpu);
+
+    // same clear color as init_GL()
+    for (int i = 0; i < w*h; i++) {
+        cpu[4*i+0] = 39;
+        cpu[4*i+1] = 40;
+        cpu[4*i+2] = 34;
+        cpu[4*i+3] = 255;
+    }
+
+    double t0 = glfwGetTime();
+    mv_ef_framebuffer fb = {cpu, w, h, 4*w, 4};
+    mv_ef_draw_cpu(&fb, str, col, offset, font_size);
+    double t1 = glfwGetTime();
+
+    // the readback is bottom-up
+    int max_diff = 0, num_off = 0;
+    double sum = 0.0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int pixel_diff = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = abs(cpu[4*(y*w + x) + c] - gpu[4*((h-1-y)*w + x) + c]);
+                if (d > pixel_diff) 
+                    pixel_diff = d;
+                sum += d;
+            }
+            if (pixel_diff > max_diff)
+                max_diff = pixel_diff;
+            if (pixel_diff > 2)
+                num_off++;
+        }
+    }
+    printf("cpu vs gpu: max difference %d, mean %.4f, %d pixels off by more than 2. cpu rendering took %.3fms\n", 
+           max_diff, sum/(3.0*w*h), num_off, 1000.0*(t1 - t0));
+
+    free(gpu);
+    free(cpu);
+}
+
 /*****************************************************************************/
 // OpenGL and GLFW boilerplate below
 void init_GL()
@@ -412,6 +287,22 @@ void key_callback(GLFWwindow* win, int key, int scancode, int action, int mods)
         SKIP_DRAWING = 1 - SKIP_DRAWING;
     }
 
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        BENCH_SMALL_TEXT = 1 - BENCH_SMALL_TEXT;
+    }
+
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        COMPARE_CPU = 1;
+    }
+
+    if (key == GLFW_KEY_UP && action) {
+        bench_font_size += 1.0;
+    }
+
+    if (key == GLFW_KEY_DOWN && action && bench_font_size > 1.0) {
+        bench_font_size -= 1.0;
+    }
+
     if (key == GLFW_KEY_SPACE && action) {
         int num_colors;
         unsigned char *colors = mv_ef_get_colors(&num_colors);
@@ -491,6 +382,12 @@ void mousewheel_callback(GLFWwindow* win, double xoffset, double yoffset) {
 //for generating a font.png for the bitmap font atlas
 //#define STB_IMAGE_WRITE_IMPLEMENTATION
 //#include "stb_image_write.h"
+//#define MV_EF_DUMP_ATLAS
 
+// lets mv_easy_font raise the driver's shader compiler thread count (KHR_parallel_shader_compile)
+#define MV_EF_GET_PROC_ADDRESS glfwGetProcAddress
 #define MV_EASY_FONT_IMPLEMENTATION
-#include "mv_easy_font.h"
\ No newline at end of file
+#include "mv_easy_font.h"
+
+#define MV_EF_HIGHLIGHT_IMPLEMENTATION
+#include "mv_ef_highlight.h"
\ No newline at end of file
@@ -0,0 +1,260 @@
+//
+// Batch text to image renderer
+//
+// Reads a list of jobs, renders each one on the cpu with mv_ef_render_images() and writes it as a PNG,
+// e.g. for dashboard thumbnails on a server without a gpu. all jobs share one headless context, so the
+// font is loaded and its atlas rasterized once, and the jobs are spread over a pool of threads.
+// Prints how many images per second it managed, rendering and PNG encoding included.
+//
+// Usage: ./render_batch [-f font] [-s atlas_size] [-o output_dir] [-j threads] [-n] [jobs.txt]
+//
+// Jobs are read from jobs.txt, or from stdin without it or with "-". One job per line:
+//
+//     width height size palette text
+//
+// palette is "-" for the defaults, or comma separated hex colors, rrggbb or rrggbbaa: the background
+// first, then colors 0, 1, 2, ... text is the rest of the line, where \n is a line break, \\ a backslash
+// and \0 to \9 switch to that color. Empty lines and lines starting with # are skipped.
+// The image of the job on line i is written to output_dir/i.png (render_batch_output by default).
+// -n renders the images without encoding or writing them. -f takes a path or a font query like "monospace"
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+#include <glad/glad.h>
+#include <glad/glad.c>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+#define MV_EASY_FONT_IMPLEMENTATION
+#include "mv_easy_font.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+typedef struct {
+    const char *output_dir;
+    int write;
+    int *lines;           // line of the jobs file of every job, for the output names
+    volatile long failed;
+} batch_output;
+
+// the text of a job, with the escapes resolved into text and col
+typedef struct {
+    char *text, *col;
+    unsigned char palette[256*3];
+} job_data;
+
+int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "rrggbb" or "rrggbbaa" up to the next comma, returns the number of channels read, 0 if malformed
+int parse_color(const char **s, unsigned char *color)
+{
+    int n = 0;
+    while (n < 4 && hex_digit((*s)[0]) >= 0 && hex_digit((*s)[1]) >= 0) {
+        color[n++] = (unsigned char)(16*hex_digit((*s)[0]) + hex_digit((*s)[1]));
+        *s += 2;
+    }
+    if (n < 3 || (**s && **s != ','))
+        return 0;
+    if (**s == ',')
+        (*s)++;
+    return n;
+}
+
+int parse_job(char *line, mv_ef_image_job *job, job_data *data)
+{
+    char palette[4096];
+    int consumed = 0;
+    if (sscanf(line, "%d %d %f %4095s %n", &job->width, &job->height, &job->size, palette, &consumed) != 4)
+        return 0;
+    if (job->width <= 0 || job->height <= 0 || job->size <= 0.0f)
+        return 0;
+
+    // the default background is the one of the example program
+    unsigned char background[4] = {39, 40, 34, 255};
+    memcpy(data->palette, mv_ef_colors, sizeof(data->palette));
+    if (strcmp(palette, "-") != 0) {
+        const char *s = palette;
+        if (parse_color(&s, background) == 0)
+            return 0;
+        for (int i = 0; *s; i++) {
+            unsigned char color[4];
+            if (i >= 256 || parse_color(&s, color) == 0)
+                return 0;
+            memcpy(data->palette + 3*i, color, 3);
+        }
+    }
+
+    const char *src = line + consumed;
+    size_t length = strlen(src);
+    data->text = (char*)malloc(length + 1);
+    data->col = (char*)malloc(length + 1);
+
+    int n = 0, color = 0;
+    for (; *src; src++) {
+        if (*src == '\\' && src[1]) {
+            src++;
+            if (*src >= '0' && *src <= '9') {
+                color = *src - '0';
+                continue;
+            }
+            data->text[n] = *src == 'n' ? '\n' : *src;
+        } else {
+            data->text[n] = *src;
+        }
+        data->col[n++] = (char)color;
+    }
+    data->text[n] = '\0';
+
+    job->text = data->text;
+    job->col = data->col;
+    job->palette = data->palette;
+    memcpy(job->background, background, 4);
+    job->offset[0] = 0.25f*job->size;
+    job->offset[1] = -0.25f*job->size;
+    return 1;
+}
+
+void write_image(int job, const mv_ef_framebuffer *fb, void *userdata)
+{
+    batch_output *output = (batch_output*)userdata;
+    if (!output->write)
+        return;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%d.png", output->output_dir, output->lines[job]);
+    if (!stbi_write_png(path, fb->width, fb->height, 4, fb->pixels, fb->stride)) {
+        printf("Error: could not write \"%s\"\n", path);
+        mv_ef_atomic_add(&output->failed, 1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char *font_name = NULL;
+    int atlas_size = 48;
+    int num_threads = 0;
+    const char *jobs_filename = "-";
+    batch_output output = {"render_batch_output", 1, NULL, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-f") && i+1 < argc)
+            font_name = argv[++i];
+        else if (!strcmp(argv[i], "-s") && i+1 < argc)
+            atlas_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)
+            output.output_dir = argv[++i];
+        else if (!strcmp(argv[i], "-j") && i+1 < argc)
+            num_threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n"))
+            output.write = 0;
+        else if (argv[i][0] != '-' || !strcmp(argv[i], "-"))
+            jobs_filename = argv[i];
+        else {
+            printf("Usage: %s [-f font] [-s atlas_size] [-o output_dir] [-j threads] [-n] [jobs.txt]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (atlas_size <= 0) {
+        printf("Error: invalid atlas size %d\n", atlas_size);
+        return 1;
+    }
+
+    FILE *fp = strcmp(jobs_filename, "-") ? fopen(jobs_filename, "r") : stdin;
+    if (!fp) {
+        printf("Error: could not open \"%s\"\n", jobs_filename);
+        return 1;
+    }
+
+    int num_jobs = 0, max_jobs = 0;
+    mv_ef_image_job *jobs = NULL;
+    job_data *data = NULL;
+
+    char line[65536];
+    for (int line_number = 1; fgets(line, sizeof(line), fp); line_number++) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        if (num_jobs == max_jobs) {
+            max_jobs = max_jobs ? 2*max_jobs : 64;
+            jobs = (mv_ef_image_job*)realloc(jobs, max_jobs*sizeof(mv_ef_image_job));
+            data = (job_data*)realloc(data, max_jobs*sizeof(job_data));
+            output.lines = (int*)realloc(output.lines, max_jobs*sizeof(int));
+        }
+        if (!parse_job(line, &jobs[num_jobs], &data[num_jobs])) {
+            printf("Warning: skipping malformed job on line %d\n", line_number);
+            continue;
+        }
+        output.lines[num_jobs++] = line_number;
+    }
+    if (fp != stdin)
+        fclose(fp);
+
+    // the palettes point into data, which may have moved while growing
+    for (int i = 0; i < num_jobs; i++)
+        jobs[i].palette = data[i].palette;
+
+    if (num_jobs == 0) {
+        printf("No jobs\n");
+        return 1;
+    }
+
+    if (output.write && make_dir(output.output_dir) != 0) {
+        struct stat st;
+        if (stat(output.output_dir, &st) != 0) {
+            printf("Error: could not create \"%s\"\n", output.output_dir);
+            return 1;
+        }
+    }
+
+    double t0 = mv_ef_time_ms();
+    mv_ef_context *ctx = mv_ef_default_context();
+    if (!mv_ef_ctx_init_headless(ctx, font_name, 0, atlas_size)) {
+        printf("Error: could not load a font\n");
+        return 1;
+    }
+
+    if (num_threads <= 0) num_threads = mv_ef_num_cpus();
+    if (num_threads > MV_EF_MAX_THREADS) num_threads = MV_EF_MAX_THREADS;
+    if (num_threads > num_jobs) num_threads = num_jobs;
+
+    double t1 = mv_ef_time_ms();
+    int num_images = mv_ef_ctx_render_images(ctx, jobs, num_jobs, num_threads, write_image, &output);
+    double t2 = mv_ef_time_ms();
+
+    printf("Font \"%s\" loaded in %.1f ms\n", mv_ef_ctx_get_font(ctx)->filename, t1 - t0);
+    printf("%d images in %.1f ms with %d thread(s), %.1f images/s%s\n", num_images, t2 - t1,
+           num_threads, 1000.0*num_images/(t2 - t1),
+           output.write ? "" : " (not written)");
+
+    mv_ef_destroy_context(ctx);
+    for (int i = 0; i < num_jobs; i++) {
+        free(data[i].text);
+        free(data[i].col);
+    }
+    free(data);
+    free(jobs);
+    free(output.lines);
+
+    return output.failed ? 1 : 0;
+}